@@ -0,0 +1,473 @@
+// Benchmark of indexing, search and removal on a generated corpus.
+// Built from all the sources of the server except main.cpp, for example
+//     g++ -std=c++17 -O2 benchmark/search_benchmark.cpp $(ls *.cpp | grep -v main.cpp) -ltbb -lpthread
+// Settings are given as key=value arguments, run with help to list them.
+// The same seed always gives the same corpus and queries.
+
+#include "../search_server.h"
+#include "../process_queries.h"
+#include "../remove_duplicates.h"
+#include "../hdr_histogram.h"
+#include "../index_allocator.h"
+#include "../scoring.h"
+
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+struct BenchmarkOptions {
+	int document_count = 50'000;
+	int vocabulary_size = 20'000;
+	// Exponent of the Zipf distribution of word frequencies, 0 for uniform
+	double zipf_exponent = 1.0;
+	int document_words = 40;
+	int query_count = 2'000;
+	int query_words = 4;
+	double minus_word_ratio = 0.1;
+	// Share of documents added again with a new id, for RemoveDuplicates
+	double duplicate_ratio = 0.05;
+	int remove_count = 1'000;
+	uint64_t seed = 42;
+	HugePageMode huge_page_mode = HugePageMode::TRANSPARENT;
+	bool prefetch = true;
+	// Only compares searches with huge pages and prefetches on and off
+	bool compare_memory = false;
+};
+
+HugePageMode ParseHugePageMode(const string& value) {
+	for (HugePageMode mode : { HugePageMode::OFF, HugePageMode::TRANSPARENT, HugePageMode::EXPLICIT }) {
+		if (value == GetHugePageModeName(mode)) {
+			return mode;
+		}
+	}
+	throw invalid_argument("Unknown huge page mode "s + value);
+}
+
+BenchmarkOptions ParseOptions(int argc, char** argv) {
+	BenchmarkOptions options;
+	const map<string, function<void(const string&)>> setters = {
+		{ "documents"s, [&options](const string& value) { options.document_count = stoi(value); } },
+		{ "vocabulary"s, [&options](const string& value) { options.vocabulary_size = stoi(value); } },
+		{ "zipf"s, [&options](const string& value) { options.zipf_exponent = stod(value); } },
+		{ "document_words"s, [&options](const string& value) { options.document_words = stoi(value); } },
+		{ "queries"s, [&options](const string& value) { options.query_count = stoi(value); } },
+		{ "query_words"s, [&options](const string& value) { options.query_words = stoi(value); } },
+		{ "minus_ratio"s, [&options](const string& value) { options.minus_word_ratio = stod(value); } },
+		{ "duplicates"s, [&options](const string& value) { options.duplicate_ratio = stod(value); } },
+		{ "removals"s, [&options](const string& value) { options.remove_count = stoi(value); } },
+		{ "seed"s, [&options](const string& value) { options.seed = stoull(value); } },
+		{ "huge_pages"s, [&options](const string& value) { options.huge_page_mode = ParseHugePageMode(value); } },
+		{ "prefetch"s, [&options](const string& value) { options.prefetch = stoi(value) != 0; } },
+		{ "compare_memory"s, [&options](const string& value) { options.compare_memory = stoi(value) != 0; } },
+	};
+	for (int i = 1; i < argc; ++i) {
+		const string argument = argv[i];
+		const size_t separator = argument.find('=');
+		const auto setter_it = separator == string::npos ? setters.end() : setters.find(argument.substr(0, separator));
+		if (setter_it == setters.end()) {
+			cerr << "Usage: search_benchmark [key=value]..., keys:"s;
+			for (const auto& [key, _] : setters) {
+				cerr << ' ' << key;
+			}
+			cerr << endl;
+			exit(argument == "help"s ? 0 : 1);
+		}
+		setter_it->second(argument.substr(separator + 1));
+	}
+	return options;
+}
+
+// Draws word ranks with probability proportional to 1 / (rank + 1)^exponent
+class ZipfDistribution {
+public:
+	ZipfDistribution(int size, double exponent)
+		: cumulative_weights_(size) {
+		double total_weight = 0.0;
+		for (int rank = 0; rank < size; ++rank) {
+			total_weight += 1.0 / pow(rank + 1.0, exponent);
+			cumulative_weights_[rank] = total_weight;
+		}
+	}
+
+	template <typename Generator>
+	int operator()(Generator& generator) const {
+		const double point = uniform_real_distribution<double>(0.0, cumulative_weights_.back())(generator);
+		const auto it = upper_bound(cumulative_weights_.begin(), cumulative_weights_.end(), point);
+		return static_cast<int>(min<ptrdiff_t>(it - cumulative_weights_.begin(), cumulative_weights_.size() - 1));
+	}
+
+private:
+	vector<double> cumulative_weights_;
+};
+
+vector<string> GenerateVocabulary(int size) {
+	vector<string> words;
+	words.reserve(size);
+	for (int i = 0; i < size; ++i) {
+		// Unique words of varying length, base 26 with a length marker
+		string word;
+		for (int rest = i; ; rest /= 26) {
+			word.push_back(static_cast<char>('a' + rest % 26));
+			if (rest < 26) {
+				break;
+			}
+		}
+		words.push_back(word + static_cast<char>('a' + i % 7));
+	}
+	return words;
+}
+
+string GenerateText(mt19937_64& generator, const vector<string>& vocabulary, const ZipfDistribution& distribution, 
+					int word_count, double minus_word_ratio) {
+	string text;
+	for (int i = 0; i < word_count; ++i) {
+		if (!text.empty()) {
+			text.push_back(' ');
+		}
+		if (minus_word_ratio > 0.0 && uniform_real_distribution<double>(0.0, 1.0)(generator) < minus_word_ratio) {
+			text.push_back('-');
+		}
+		text += vocabulary[distribution(generator)];
+	}
+	return text;
+}
+
+size_t GetPeakResidentSetKilobytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize / 1024;
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return static_cast<size_t>(usage.ru_maxrss);
+#endif
+}
+
+// Data TLB load misses of the calling thread, where the kernel lets perf events be read
+class TlbMissCounter {
+public:
+	TlbMissCounter() {
+#ifdef __linux__
+		perf_event_attr attributes{};
+		attributes.type = PERF_TYPE_HW_CACHE;
+		attributes.size = sizeof(attributes);
+		attributes.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		descriptor_ = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+		if (descriptor_ >= 0) {
+			ioctl(descriptor_, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	~TlbMissCounter() {
+#ifdef __linux__
+		if (descriptor_ >= 0) {
+			close(descriptor_);
+		}
+#endif
+	}
+
+	TlbMissCounter(const TlbMissCounter&) = delete;
+	TlbMissCounter& operator=(const TlbMissCounter&) = delete;
+
+	bool IsAvailable() const {
+		return descriptor_ >= 0;
+	}
+
+	uint64_t Read() const {
+		uint64_t count = 0;
+#ifdef __linux__
+		if (descriptor_ >= 0 && read(descriptor_, &count, sizeof(count)) != sizeof(count)) {
+			count = 0;
+		}
+#endif
+		return count;
+	}
+
+private:
+	int descriptor_ = -1;
+};
+
+using Clock = chrono::steady_clock;
+
+class OperationReport {
+public:
+	explicit OperationReport(string name)
+		: name_(move(name)) {
+	}
+
+	// Runs the operation and records its latency
+	template <typename Operation>
+	void Measure(Operation operation) {
+		const auto start_time = Clock::now();
+		operation();
+		const auto latency = Clock::now() - start_time;
+		latencies_.Record(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(latency).count()));
+		total_time_ += latency;
+	}
+
+	uint64_t GetCount() const {
+		return latencies_.GetTotalCount();
+	}
+
+	// items_per_operation counts the documents or queries handled by one operation
+	void Print(ostream& out, int items_per_operation = 1) const {
+		const double seconds = chrono::duration<double>(total_time_).count();
+		const double items = static_cast<double>(latencies_.GetTotalCount()) * items_per_operation;
+		out << left << setw(24) << name_ << right
+			<< setw(10) << latencies_.GetTotalCount()
+			<< setw(14) << fixed << setprecision(0) << (seconds > 0.0 ? items / seconds : 0.0)
+			<< setw(12) << setprecision(1) << latencies_.GetValueAtQuantile(0.5) / 1000.0
+			<< setw(12) << latencies_.GetValueAtQuantile(0.99) / 1000.0
+			<< setw(14) << GetPeakResidentSetKilobytes() / 1024.0 << defaultfloat << endl;
+	}
+
+private:
+	string name_;
+	HdrHistogram latencies_;
+	Clock::duration total_time_{};
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	const BenchmarkOptions options = ParseOptions(argc, argv);
+
+	mt19937_64 generator(options.seed);
+	const auto vocabulary = GenerateVocabulary(options.vocabulary_size);
+	const ZipfDistribution distribution(options.vocabulary_size, options.zipf_exponent);
+
+	vector<string> documents;
+	documents.reserve(options.document_count);
+	for (int i = 0; i < options.document_count; ++i) {
+		const bool is_duplicate = i > 0 && uniform_real_distribution<double>(0.0, 1.0)(generator) < options.duplicate_ratio;
+		documents.push_back(is_duplicate
+			? documents[uniform_int_distribution<int>(0, i - 1)(generator)]
+			: GenerateText(generator, vocabulary, distribution, options.document_words, 0.0));
+	}
+	vector<string> queries;
+	queries.reserve(options.query_count);
+	for (int i = 0; i < options.query_count; ++i) {
+		queries.push_back(GenerateText(generator, vocabulary, distribution, options.query_words, options.minus_word_ratio));
+	}
+
+	cout << "documents="s << options.document_count << " vocabulary="s << options.vocabulary_size
+		<< " zipf="s << options.zipf_exponent << " document_words="s << options.document_words
+		<< " queries="s << options.query_count << " query_words="s << options.query_words
+		<< " minus_ratio="s << options.minus_word_ratio << " seed="s << options.seed
+		<< " huge_pages="s << GetHugePageModeName(options.huge_page_mode) << " prefetch="s << options.prefetch << endl;
+	cout << left << setw(24) << "operation"s << right << setw(10) << "count"s << setw(14) << "items/s"s
+		<< setw(12) << "p50 us"s << setw(12) << "p99 us"s << setw(14) << "peak RSS MB"s << endl;
+
+	if (options.compare_memory) {
+		// Every configuration indexes the corpus anew, as huge pages are chosen when buffers are allocated
+		map<string, double> tlb_misses_per_query;
+		double total_relevance = 0.0;
+		for (HugePageMode mode : { HugePageMode::OFF, options.huge_page_mode == HugePageMode::OFF ? HugePageMode::TRANSPARENT : options.huge_page_mode }) {
+			SetHugePageMode(mode);
+			SearchServer search_server("a"sv);
+			for (int id = 0; id < options.document_count; ++id) {
+				search_server.AddDocument(id, documents[id], DocumentStatus::ACTUAL, { id % 10 });
+			}
+			for (bool prefetch : { false, true }) {
+				SetScoringPrefetch(prefetch);
+				// Huge page mode, then whether the scoring loop prefetches
+				const string name = string(GetHugePageModeName(mode)) + (prefetch ? " prefetch"s : ""s);
+				OperationReport report(name);
+				TlbMissCounter tlb_misses;
+				const uint64_t first_tlb_miss_count = tlb_misses.Read();
+				for (const string& query : queries) {
+					report.Measure([&] {
+						for (const Document& document : search_server.FindTopDocuments(execution::seq, query)) {
+							total_relevance += document.relevance;
+						}
+						});
+				}
+				if (tlb_misses.IsAvailable()) {
+					tlb_misses_per_query[name] = static_cast<double>(tlb_misses.Read() - first_tlb_miss_count) / report.GetCount();
+				}
+				report.Print(cout);
+			}
+		}
+		cout << "dTLB load misses per query:"s;
+		if (tlb_misses_per_query.empty()) {
+			cout << " n/a, perf events are not available"s;
+		}
+		for (const auto& [name, misses] : tlb_misses_per_query) {
+			cout << endl << "  "s << name << ": "s << fixed << setprecision(1) << misses << defaultfloat;
+		}
+		cout << endl << "checksum: "s << total_relevance << endl;
+		return 0;
+	}
+
+	SetHugePageMode(options.huge_page_mode);
+	SetScoringPrefetch(options.prefetch);
+	SearchServer search_server("a"sv);
+	OperationReport add_report("AddDocument"s);
+	for (int id = 0; id < options.document_count; ++id) {
+		add_report.Measure([&] {
+			search_server.AddDocument(id, documents[id], DocumentStatus::ACTUAL, { id % 10 });
+			});
+	}
+	add_report.Print(cout);
+	const IndexStatistics statistics = search_server.GetIndexStatistics();
+
+	double total_relevance = 0.0;
+	OperationReport seq_report("FindTopDocuments seq"s);
+	for (const string& query : queries) {
+		seq_report.Measure([&] {
+			for (const Document& document : search_server.FindTopDocuments(execution::seq, query)) {
+				total_relevance += document.relevance;
+			}
+			});
+	}
+	seq_report.Print(cout);
+
+	OperationReport par_report("FindTopDocuments par"s);
+	for (const string& query : queries) {
+		par_report.Measure([&] {
+			for (const Document& document : search_server.FindTopDocuments(execution::par, query)) {
+				total_relevance += document.relevance;
+			}
+			});
+	}
+	par_report.Print(cout);
+
+	QueryOptions all_words_options;
+	all_words_options.minimum_should_match = ALL_QUERY_WORDS;
+	OperationReport all_words_report("FindTopDocuments and"s);
+	for (const string& query : queries) {
+		all_words_report.Measure([&] {
+			for (const Document& document : search_server.FindTopDocuments(execution::seq, query, all_words_options)) {
+				total_relevance += document.relevance;
+			}
+			});
+	}
+	all_words_report.Print(cout);
+
+	{
+		// Same queries with the index placed on the NUMA nodes of this machine
+		NumaExecutor executor(DetectNumaTopology());
+		search_server.PlaceOnNumaNodes(executor);
+		OperationReport numa_report("FindTopDocuments numa x"s + to_string(executor.GetNodeCount()));
+		for (const string& query : queries) {
+			numa_report.Measure([&] {
+				const auto prepared_query = search_server.PrepareQuery(query);
+				for (const Document& document : search_server.FindTopDocuments(NumaPolicy{ &executor }, prepared_query)) {
+					total_relevance += document.relevance;
+				}
+				});
+		}
+		numa_report.Print(cout);
+	}
+
+	OperationReport match_report("MatchDocument"s);
+	size_t matched_word_count = 0;
+	for (const string& query : queries) {
+		const int document_id = uniform_int_distribution<int>(0, options.document_count - 1)(generator);
+		match_report.Measure([&] {
+			matched_word_count += get<0>(search_server.MatchDocument(query, document_id)).size();
+			});
+	}
+	match_report.Print(cout);
+
+	const size_t batch_size = 100;
+	OperationReport process_report("ProcessQueries x100"s);
+	for (size_t first = 0; first + batch_size <= queries.size(); first += batch_size) {
+		const vector<string> batch(queries.begin() + first, queries.begin() + first + batch_size);
+		process_report.Measure([&] {
+			total_relevance += ProcessQueries(search_server, batch).size();
+			});
+	}
+	process_report.Print(cout, static_cast<int>(batch_size));
+
+	OperationReport joined_report("ProcessQueriesJoined x100"s);
+	for (size_t first = 0; first + batch_size <= queries.size(); first += batch_size) {
+		const vector<string> batch(queries.begin() + first, queries.begin() + first + batch_size);
+		joined_report.Measure([&] {
+			for (const Document& document : ProcessQueriesJoined(search_server, batch)) {
+				total_relevance += document.relevance;
+			}
+			});
+	}
+	joined_report.Print(cout, static_cast<int>(batch_size));
+
+	OperationReport duplicates_report("RemoveDuplicates"s);
+	size_t duplicate_count = 0;
+	{
+		// RemoveDuplicates reports every duplicate, which is not what is measured here
+		ostringstream discarded;
+		auto* const cout_buffer = cout.rdbuf(discarded.rdbuf());
+		duplicates_report.Measure([&] {
+			duplicate_count = RemoveDuplicates(search_server).size();
+			});
+		cout.rdbuf(cout_buffer);
+	}
+	duplicates_report.Print(cout);
+
+	vector<int> remaining_ids(search_server.begin(), search_server.end());
+	shuffle(remaining_ids.begin(), remaining_ids.end(), generator);
+	remaining_ids.resize(min<size_t>(remaining_ids.size(), options.remove_count));
+	OperationReport remove_report("RemoveDocument"s);
+	for (const int document_id : remaining_ids) {
+		remove_report.Measure([&] {
+			search_server.RemoveDocument(document_id);
+			});
+	}
+	remove_report.Print(cout);
+
+	// Half of what is left in one call, as a purge of expired documents would
+	vector<int> purged_ids(search_server.begin(), search_server.end());
+	shuffle(purged_ids.begin(), purged_ids.end(), generator);
+	purged_ids.resize(purged_ids.size() / 2);
+	OperationReport purge_report("RemoveDocuments par"s);
+	purge_report.Measure([&] {
+		search_server.RemoveDocuments(execution::par, purged_ids);
+		});
+	purge_report.Print(cout, static_cast<int>(purged_ids.size()));
+
+	const auto to_megabytes = [](size_t bytes) {
+		return bytes / 1024.0 / 1024.0;
+	};
+	const IndexMemoryUsage& memory_usage = statistics.memory_usage;
+	cout << "index after AddDocument: terms="s << statistics.term_count << " postings="s << statistics.posting_count
+		<< fixed << setprecision(1) << " MB: dictionary="s << to_megabytes(memory_usage.dictionary)
+		<< " postings="s << to_megabytes(memory_usage.postings) << " forward_index="s << to_megabytes(memory_usage.forward_index)
+		<< " metadata="s << to_megabytes(memory_usage.metadata) << " total="s << to_megabytes(memory_usage.GetTotal())
+		<< defaultfloat << endl;
+
+	// Printed so that the measured work cannot be optimized away
+	cout << "checksum: "s << total_relevance << ' ' << matched_word_count << ' ' << duplicate_count << endl;
+}
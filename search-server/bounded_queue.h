@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// Blocking FIFO for handing work between pipeline stages. Push waits while the
+// queue is full, so a fast producer cannot run ahead of its consumers.
+template <typename T>
+class BoundedQueue {
+public:
+	explicit BoundedQueue(size_t capacity)
+		: capacity_(capacity) {
+	}
+
+	// False if the queue was closed, the value is then dropped
+	bool Push(T value) {
+		std::unique_lock lock(mutex_);
+		not_full_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+		if (closed_) {
+			return false;
+		}
+		items_.push_back(std::move(value));
+		not_empty_.notify_one();
+		return true;
+	}
+
+	// False once the queue is closed and every pushed value has been popped
+	bool Pop(T& value) {
+		std::unique_lock lock(mutex_);
+		not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+		if (items_.empty()) {
+			return false;
+		}
+		value = std::move(items_.front());
+		items_.pop_front();
+		not_full_.notify_one();
+		return true;
+	}
+
+	void Close() {
+		std::lock_guard lock(mutex_);
+		closed_ = true;
+		not_full_.notify_all();
+		not_empty_.notify_all();
+	}
+
+private:
+	const size_t capacity_;
+	std::mutex mutex_;
+	std::condition_variable not_full_;
+	std::condition_variable not_empty_;
+	std::deque<T> items_;
+	bool closed_ = false;
+};
@@ -1,71 +1,284 @@
-#pragma once
-
-#include "basic_iterator.h"
-
-#include <cstdlib>
-#include <map>
-#include <numeric>
-#include <string>
-#include <vector>
-#include <mutex>
-#include <algorithm>
-
-template <typename Key, typename Value>
-class ConcurrentMap {
-	typedef typename std::vector<std::map<Key, Value>>::iterator ExternalIterator;
-	typedef typename std::map<Key, Value>::iterator InternalIterator;
-
-	using BasicIterator = BasicIterator<std::pair<const Key, Value>, InternalIterator, ExternalIterator>;
-
-public:
-
-	static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
-
-	struct Access {
-		std::lock_guard<std::mutex> guard;
-		Value& ref_to_value;
-
-		Access(std::mutex& value_mutex, std::map<Key, Value>& map, const Key& key) : guard(value_mutex), ref_to_value(map[key]) {}
-	};
-
-	explicit ConcurrentMap(size_t bucket_count) : maps_(bucket_count), mutex_values_(bucket_count) {
-	}
-
-	Access operator[](const Key& key) {
-		uint64_t ukey = key;
-		size_t index = ukey % maps_.size();
-
-		return Access(mutex_values_[index], maps_[index], key);
-	}
-
-	void erase(const Key& key) {
-		uint64_t ukey = key;
-		size_t index = ukey % maps_.size();
-
-		std::lock_guard guard(mutex_values_[index]);
-		maps_[index].erase(key);
-	}
-
-	std::map<Key, Value> BuildOrdinaryMap() {
-		std::map<Key, Value> result;
-
-		for (size_t i = 0; i < maps_.size(); ++i) {
-			std::lock_guard guard(mutex_values_[i]);
-			result.insert(maps_[i].begin(), maps_[i].end());
-		}
-
-		return result;
-	}
-
-	BasicIterator begin() {
-		return BasicIterator(maps_.begin(), maps_.end());
-	}
-
-	BasicIterator end() {
-		return BasicIterator(maps_.end(), maps_.end());
-	}
-
-private:
-	std::vector<std::map<Key, Value>> maps_;
-	std::vector<std::mutex> mutex_values_;
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Test-and-test-and-set lock for critical sections of a few instructions
+class SpinLock {
+public:
+	void lock() noexcept {
+		for (int spins = 0; locked_.exchange(true, std::memory_order_acquire); ++spins) {
+			while (locked_.load(std::memory_order_relaxed)) {
+				if (++spins > 64) {
+					std::this_thread::yield();
+				}
+			}
+		}
+	}
+
+	void unlock() noexcept {
+		locked_.store(false, std::memory_order_release);
+	}
+
+private:
+	std::atomic<bool> locked_ = false;
+};
+
+// Hash map of integer keys split into shards, each an open-addressing table with
+// linear probing under its own spinlock. Shards sit on separate cache lines, so
+// threads updating different shards never contend for one.
+template <typename Key, typename Value>
+class ConcurrentMap {
+	struct Slot {
+		Key key;
+		Value value;
+		bool is_used = false;
+	};
+
+	struct alignas(64) Shard {
+		SpinLock lock;
+		// Size is zero or a power of two, at most 3/4 of the slots are used
+		std::vector<Slot> slots;
+		size_t size = 0;
+	};
+
+public:
+	static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
+
+	class Iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = std::pair<Key, Value>;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = std::pair<const Key&, Value&>;
+
+		Iterator(std::vector<Shard>& shards, size_t shard_index, size_t slot_index)
+			: shards_(&shards), shard_index_(shard_index), slot_index_(slot_index) {
+			SkipUnusedSlots();
+		}
+
+		reference operator*() const {
+			Slot& slot = (*shards_)[shard_index_].slots[slot_index_];
+			return { slot.key, slot.value };
+		}
+
+		Iterator& operator++() {
+			++slot_index_;
+			SkipUnusedSlots();
+			return *this;
+		}
+
+		bool operator==(const Iterator& rhs) const {
+			return shard_index_ == rhs.shard_index_ && slot_index_ == rhs.slot_index_;
+		}
+
+		bool operator!=(const Iterator& rhs) const {
+			return !(*this == rhs);
+		}
+
+	private:
+		std::vector<Shard>* shards_;
+		size_t shard_index_;
+		size_t slot_index_;
+
+		void SkipUnusedSlots() {
+			while (shard_index_ < shards_->size()) {
+				const auto& slots = (*shards_)[shard_index_].slots;
+				while (slot_index_ < slots.size() && !slots[slot_index_].is_used) {
+					++slot_index_;
+				}
+				if (slot_index_ < slots.size()) {
+					return;
+				}
+				++shard_index_;
+				slot_index_ = 0;
+			}
+		}
+	};
+
+	// Holds the lock of the shard of the key while the value is used
+	struct Access {
+		std::lock_guard<SpinLock> guard;
+		Value& ref_to_value;
+
+		Access(Shard& shard, const Key& key, uint64_t hash) : guard(shard.lock), ref_to_value(FindOrInsert(shard, key, hash)) {}
+	};
+
+	// expected_size, if known, spares the shards from growing while they are filled
+	explicit ConcurrentMap(size_t bucket_count, size_t expected_size = 0) : shards_(std::max<size_t>(bucket_count, 1)) {
+		if (expected_size > 0) {
+			const size_t shard_size = expected_size / shards_.size() + 1;
+			for (Shard& shard : shards_) {
+				Reserve(shard, shard_size);
+			}
+		}
+	}
+
+	Access operator[](const Key& key) {
+		const uint64_t hash = Hash(key);
+		return Access(GetShard(hash), key, hash);
+	}
+
+	// map[key] += delta, with the lock held only for the addition
+	void Add(const Key& key, const Value& delta) {
+		const uint64_t hash = Hash(key);
+		Shard& shard = GetShard(hash);
+		std::lock_guard guard(shard.lock);
+		FindOrInsert(shard, key, hash) += delta;
+	}
+
+	void erase(const Key& key) {
+		const uint64_t hash = Hash(key);
+		Shard& shard = GetShard(hash);
+		std::lock_guard guard(shard.lock);
+		Erase(shard, key, hash);
+	}
+
+	// Not synchronized with concurrent writers
+	size_t size() const {
+		size_t result = 0;
+		for (const Shard& shard : shards_) {
+			result += shard.size;
+		}
+		return result;
+	}
+
+	// Calls function(key, value) for every entry, locking one shard at a time.
+	// Shards are visited in parallel under a parallel policy.
+	template <typename Policy, typename Function>
+	void ForEach(Policy policy, Function function) {
+		std::for_each(policy, shards_.begin(), shards_.end(), [&function](Shard& shard) {
+			std::lock_guard guard(shard.lock);
+			for (Slot& slot : shard.slots) {
+				if (slot.is_used) {
+					function(slot.key, slot.value);
+				}
+			}
+			});
+	}
+
+	template <typename Function>
+	void ForEach(Function function) {
+		ForEach(std::execution::seq, function);
+	}
+
+	std::map<Key, Value> BuildOrdinaryMap() {
+		std::map<Key, Value> result;
+		ForEach([&result](const Key& key, const Value& value) {
+			result.emplace(key, value);
+			});
+		return result;
+	}
+
+	// All the entries merged into one vector, in no particular order
+	std::vector<std::pair<Key, Value>> BuildVector() {
+		std::vector<std::pair<Key, Value>> result;
+		result.reserve(size());
+		ForEach([&result](const Key& key, const Value& value) {
+			result.emplace_back(key, value);
+			});
+		return result;
+	}
+
+	// Iteration takes no locks, it must not run concurrently with writers
+	Iterator begin() {
+		return Iterator(shards_, 0, 0);
+	}
+
+	Iterator end() {
+		return Iterator(shards_, shards_.size(), 0);
+	}
+
+private:
+	std::vector<Shard> shards_;
+
+	static uint64_t Hash(const Key& key) {
+		// Fibonacci hashing spreads consecutive ids over both the shards and the slots
+		return static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull;
+	}
+
+	Shard& GetShard(uint64_t hash) {
+		return shards_[(hash >> 40) % shards_.size()];
+	}
+
+	static size_t GetHomeSlot(const Shard& shard, uint64_t hash) {
+		return static_cast<size_t>(hash >> 7) & (shard.slots.size() - 1);
+	}
+
+	static void Reserve(Shard& shard, size_t size) {
+		size_t capacity = std::max<size_t>(shard.slots.size(), 8);
+		while (size * 4 > capacity * 3) {
+			capacity *= 2;
+		}
+		if (capacity == shard.slots.size()) {
+			return;
+		}
+		std::vector<Slot> old_slots(capacity);
+		shard.slots.swap(old_slots);
+		for (Slot& old_slot : old_slots) {
+			if (old_slot.is_used) {
+				size_t index = GetHomeSlot(shard, Hash(old_slot.key));
+				while (shard.slots[index].is_used) {
+					index = (index + 1) & (shard.slots.size() - 1);
+				}
+				shard.slots[index] = std::move(old_slot);
+			}
+		}
+	}
+
+	static Value& FindOrInsert(Shard& shard, const Key& key, uint64_t hash) {
+		Reserve(shard, shard.size + 1);
+		for (size_t index = GetHomeSlot(shard, hash);; index = (index + 1) & (shard.slots.size() - 1)) {
+			Slot& slot = shard.slots[index];
+			if (!slot.is_used) {
+				slot = { key, Value(), true };
+				++shard.size;
+				return slot.value;
+			}
+			if (slot.key == key) {
+				return slot.value;
+			}
+		}
+	}
+
+	static void Erase(Shard& shard, const Key& key, uint64_t hash) {
+		if (shard.size == 0) {
+			return;
+		}
+		const size_t mask = shard.slots.size() - 1;
+		size_t hole = GetHomeSlot(shard, hash);
+		while (shard.slots[hole].is_used && shard.slots[hole].key != key) {
+			hole = (hole + 1) & mask;
+		}
+		if (!shard.slots[hole].is_used) {
+			return;
+		}
+		shard.slots[hole].is_used = false;
+		--shard.size;
+
+		// Backward shift: entries probed past the hole move into it, so lookups
+		// never need tombstones
+		for (size_t index = (hole + 1) & mask; shard.slots[index].is_used; index = (index + 1) & mask) {
+			const size_t home = GetHomeSlot(shard, Hash(shard.slots[index].key));
+			// The entry stays if its home lies cyclically in (hole, index]
+			const bool stays = hole <= index ? (hole < home && home <= index) : (hole < home || home <= index);
+			if (!stays) {
+				shard.slots[hole] = std::move(shard.slots[index]);
+				shard.slots[index].is_used = false;
+				hole = index;
+			}
+		}
+	}
 };
\ No newline at end of file
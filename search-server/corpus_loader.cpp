@@ -0,0 +1,512 @@
+#include "corpus_loader.h"
+#include "bounded_queue.h"
+
+#include <algorithm>
+#include <charconv>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Read-only view of a whole file, paged in by the OS as it is read
+class MappedFile {
+public:
+	explicit MappedFile(const string& path) {
+#ifdef _WIN32
+		file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		LARGE_INTEGER size;
+		if (file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_, &size)) {
+			Close();
+			throw runtime_error("Cannot open corpus file "s + path);
+		}
+		size_ = static_cast<size_t>(size.QuadPart);
+		if (size_ > 0) {
+			mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			data_ = mapping_ ? static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+			if (!data_) {
+				Close();
+				throw runtime_error("Cannot map corpus file "s + path);
+			}
+		}
+#else
+		file_ = open(path.c_str(), O_RDONLY);
+		struct stat file_stat;
+		if (file_ < 0 || fstat(file_, &file_stat) != 0) {
+			Close();
+			throw runtime_error("Cannot open corpus file "s + path);
+		}
+		size_ = static_cast<size_t>(file_stat.st_size);
+		if (size_ > 0) {
+			void* const data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file_, 0);
+			if (data == MAP_FAILED) {
+				Close();
+				throw runtime_error("Cannot map corpus file "s + path);
+			}
+			data_ = static_cast<const char*>(data);
+			madvise(data, size_, MADV_SEQUENTIAL);
+		}
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile() {
+		Close();
+	}
+
+	string_view GetData() const {
+		return { data_, size_ };
+	}
+
+private:
+	const char* data_ = nullptr;
+	size_t size_ = 0;
+#ifdef _WIN32
+	HANDLE file_ = INVALID_HANDLE_VALUE;
+	HANDLE mapping_ = nullptr;
+
+	void Close() {
+		if (data_) {
+			UnmapViewOfFile(data_);
+		}
+		if (mapping_) {
+			CloseHandle(mapping_);
+		}
+		if (file_ != INVALID_HANDLE_VALUE) {
+			CloseHandle(file_);
+		}
+		data_ = nullptr;
+		mapping_ = nullptr;
+		file_ = INVALID_HANDLE_VALUE;
+	}
+#else
+	int file_ = -1;
+
+	void Close() {
+		if (data_) {
+			munmap(const_cast<char*>(data_), size_);
+		}
+		if (file_ >= 0) {
+			close(file_);
+		}
+		data_ = nullptr;
+		file_ = -1;
+	}
+#endif
+};
+
+struct ParsedDocument {
+	int id = 0;
+	DocumentStatus status = DocumentStatus::ACTUAL;
+	vector<int> ratings;
+	// Views the corpus itself unless the text had to be unescaped
+	string_view text;
+	string unescaped_text;
+	bool is_unescaped = false;
+
+	string_view GetText() const {
+		return is_unescaped ? string_view(unescaped_text) : text;
+	}
+};
+
+[[noreturn]] void ThrowMalformedLine(size_t offset, const string& reason) {
+	throw invalid_argument("Malformed corpus line at byte "s + to_string(offset) + ": "s + reason);
+}
+
+int ParseInt(string_view text, size_t offset) {
+	int value = 0;
+	const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+	if (error != errc{} || end != text.data() + text.size()) {
+		ThrowMalformedLine(offset, "invalid number "s + string(text));
+	}
+	return value;
+}
+
+DocumentStatus ParseStatus(string_view text, size_t offset) {
+	if (text == "ACTUAL"sv) {
+		return DocumentStatus::ACTUAL;
+	}
+	if (text == "IRRELEVANT"sv) {
+		return DocumentStatus::IRRELEVANT;
+	}
+	if (text == "BANNED"sv) {
+		return DocumentStatus::BANNED;
+	}
+	if (text == "REMOVED"sv) {
+		return DocumentStatus::REMOVED;
+	}
+	ThrowMalformedLine(offset, "unknown status "s + string(text));
+}
+
+ParsedDocument ParseTsvLine(string_view line, size_t offset) {
+	string_view fields[3];
+	for (string_view& field : fields) {
+		const size_t tab = line.find('\t');
+		if (tab == string_view::npos) {
+			ThrowMalformedLine(offset, "expected id, status, ratings and text"s);
+		}
+		field = line.substr(0, tab);
+		line.remove_prefix(tab + 1);
+	}
+
+	ParsedDocument document;
+	document.id = ParseInt(fields[0], offset);
+	document.status = ParseStatus(fields[1], offset);
+	for (const string_view rating : SplitIntoWords(fields[2])) {
+		if (!rating.empty()) {
+			document.ratings.push_back(ParseInt(rating, offset));
+		}
+	}
+	document.text = line;
+	return document;
+}
+
+void AppendUtf8(uint32_t code_point, string& out) {
+	if (code_point < 0x80) {
+		out.push_back(static_cast<char>(code_point));
+	}
+	else if (code_point < 0x800) {
+		out.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+		out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+	}
+	else if (code_point < 0x10000) {
+		out.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+		out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+		out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+	}
+	else {
+		out.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+		out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+		out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+		out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+	}
+}
+
+// Just enough JSON for one flat object per line: string, number and
+// number array values, other values of unknown keys are skipped
+class JsonLineParser {
+public:
+	JsonLineParser(string_view line, size_t offset)
+		: line_(line)
+		, offset_(offset) {
+	}
+
+	ParsedDocument Parse() {
+		ParsedDocument document;
+		bool has_id = false;
+		bool has_text = false;
+
+		Expect('{');
+		if (!Consume('}')) {
+			do {
+				string key_storage;
+				bool is_escaped = false;
+				const string_view key = ParseString(key_storage, is_escaped);
+				Expect(':');
+				if (key == "id"sv) {
+					document.id = ParseNumber();
+					has_id = true;
+				}
+				else if (key == "status"sv) {
+					string status_storage;
+					document.status = ParseStatus(ParseString(status_storage, is_escaped), offset_);
+				}
+				else if (key == "ratings"sv) {
+					document.ratings = ParseNumberArray();
+				}
+				else if (key == "text"sv) {
+					document.text = ParseString(document.unescaped_text, document.is_unescaped);
+					has_text = true;
+				}
+				else {
+					SkipValue();
+				}
+			} while (Consume(','));
+			Expect('}');
+		}
+		SkipSpaces();
+		if (position_ != line_.size()) {
+			ThrowMalformedLine(offset_, "text after the object"s);
+		}
+		if (!has_id || !has_text) {
+			ThrowMalformedLine(offset_, "id and text are required"s);
+		}
+		return document;
+	}
+
+private:
+	string_view line_;
+	size_t position_ = 0;
+	size_t offset_;
+
+	void SkipSpaces() {
+		while (position_ < line_.size() && (line_[position_] == ' ' || line_[position_] == '\t')) {
+			++position_;
+		}
+	}
+
+	bool Consume(char c) {
+		SkipSpaces();
+		if (position_ < line_.size() && line_[position_] == c) {
+			++position_;
+			return true;
+		}
+		return false;
+	}
+
+	void Expect(char c) {
+		if (!Consume(c)) {
+			ThrowMalformedLine(offset_, "expected "s + c);
+		}
+	}
+
+	// A view of the line when the string has no escapes, of storage otherwise
+	string_view ParseString(string& storage, bool& is_escaped) {
+		Expect('"');
+		const size_t begin = position_;
+		const size_t end = line_.find_first_of("\"\\"sv, begin);
+		if (end == string_view::npos) {
+			ThrowMalformedLine(offset_, "unterminated string"s);
+		}
+		if (line_[end] == '"') {
+			position_ = end + 1;
+			is_escaped = false;
+			return line_.substr(begin, end - begin);
+		}
+
+		storage.assign(line_.substr(begin, end - begin));
+		position_ = end;
+		while (true) {
+			if (position_ >= line_.size()) {
+				ThrowMalformedLine(offset_, "unterminated string"s);
+			}
+			const char c = line_[position_++];
+			if (c == '"') {
+				break;
+			}
+			if (c != '\\') {
+				storage.push_back(c);
+				continue;
+			}
+			if (position_ >= line_.size()) {
+				ThrowMalformedLine(offset_, "unterminated string"s);
+			}
+			switch (const char escape = line_[position_++]) {
+			case 'n':
+				storage.push_back('\n');
+				break;
+			case 't':
+				storage.push_back('\t');
+				break;
+			case 'r':
+				storage.push_back('\r');
+				break;
+			case 'b':
+				storage.push_back('\b');
+				break;
+			case 'f':
+				storage.push_back('\f');
+				break;
+			case 'u': {
+				uint32_t code_point = ParseHex4();
+				if (code_point >= 0xD800 && code_point < 0xDC00 && line_.substr(position_, 2) == "\\u"sv) {
+					position_ += 2;
+					code_point = 0x10000 + ((code_point - 0xD800) << 10) + (ParseHex4() - 0xDC00);
+				}
+				AppendUtf8(code_point, storage);
+				break;
+			}
+			default:
+				storage.push_back(escape);
+			}
+		}
+		is_escaped = true;
+		return storage;
+	}
+
+	uint32_t ParseHex4() {
+		uint32_t value = 0;
+		const auto [end, error] = from_chars(line_.data() + position_, line_.data() + min(position_ + 4, line_.size()), value, 16);
+		if (error != errc{} || end != line_.data() + position_ + 4) {
+			ThrowMalformedLine(offset_, "invalid \\u escape"s);
+		}
+		position_ += 4;
+		return value;
+	}
+
+	int ParseNumber() {
+		SkipSpaces();
+		const size_t end = line_.find_first_of(",]} \t"sv, position_);
+		const string_view number = line_.substr(position_, end == string_view::npos ? string_view::npos : end - position_);
+		position_ += number.size();
+		return ParseInt(number, offset_);
+	}
+
+	vector<int> ParseNumberArray() {
+		vector<int> numbers;
+		Expect('[');
+		if (!Consume(']')) {
+			do {
+				numbers.push_back(ParseNumber());
+			} while (Consume(','));
+			Expect(']');
+		}
+		return numbers;
+	}
+
+	void SkipValue() {
+		SkipSpaces();
+		if (position_ < line_.size() && line_[position_] == '"') {
+			string storage;
+			bool is_escaped = false;
+			ParseString(storage, is_escaped);
+			return;
+		}
+		// Numbers, literals and arrays or objects without strings containing brackets
+		int depth = 0;
+		while (position_ < line_.size()) {
+			const char c = line_[position_];
+			if (c == '[' || c == '{') {
+				++depth;
+			}
+			else if (c == ']' || c == '}') {
+				if (depth == 0) {
+					return;
+				}
+				--depth;
+			}
+			else if (c == ',' && depth == 0) {
+				return;
+			}
+			++position_;
+		}
+	}
+};
+
+// The documents of a chunk, split into words by a parser so that the indexer only indexes them
+struct ParsedChunk {
+	// Hold the unescaped texts the words of documents view
+	vector<ParsedDocument> parsed_documents;
+	vector<TokenizedDocument> documents;
+};
+
+ParsedChunk ParseChunk(const SearchServer& search_server, string_view chunk, size_t chunk_offset, CorpusFormat format) {
+	vector<ParsedDocument> documents;
+	for (size_t line_begin = 0; line_begin < chunk.size();) {
+		size_t line_end = chunk.find('\n', line_begin);
+		if (line_end == string_view::npos) {
+			line_end = chunk.size();
+		}
+		string_view line = chunk.substr(line_begin, line_end - line_begin);
+		if (!line.empty() && line.back() == '\r') {
+			line.remove_suffix(1);
+		}
+		if (!line.empty()) {
+			const size_t offset = chunk_offset + line_begin;
+			documents.push_back(format == CorpusFormat::TSV ? ParseTsvLine(line, offset) : JsonLineParser(line, offset).Parse());
+		}
+		line_begin = line_end + 1;
+	}
+
+	// The parsed documents no longer move, so their texts can be viewed
+	ParsedChunk parsed_chunk{ move(documents), {} };
+	parsed_chunk.documents.resize(parsed_chunk.parsed_documents.size());
+	for (size_t i = 0; i < parsed_chunk.documents.size(); ++i) {
+		ParsedDocument& parsed_document = parsed_chunk.parsed_documents[i];
+		TokenizedDocument& document = parsed_chunk.documents[i];
+		document.id = parsed_document.id;
+		document.status = parsed_document.status;
+		document.ratings = move(parsed_document.ratings);
+		search_server.TokenizeDocument(parsed_document.GetText(), document);
+	}
+	return parsed_chunk;
+}
+
+}  // namespace
+
+CorpusLoadStats LoadCorpus(SearchServer& search_server, string_view corpus, const CorpusLoadOptions& options) {
+	if (options.chunk_size == 0 || options.parser_count == 0 || options.max_pending_chunks == 0) {
+		throw invalid_argument("Corpus chunk size, parser count and pending chunk count must be positive"s);
+	}
+
+	// Reader: cuts the corpus into chunks at line ends. Its futures go to the indexer in
+	// corpus order, and the tasks behind them to the parsers.
+	using ParseTask = packaged_task<ParsedChunk()>;
+	BoundedQueue<future<ParsedChunk>> parsed_chunks(options.max_pending_chunks);
+	BoundedQueue<ParseTask> parse_tasks(options.max_pending_chunks);
+
+	thread reader([&] {
+		for (size_t chunk_begin = 0; chunk_begin < corpus.size();) {
+			size_t chunk_end = min(chunk_begin + options.chunk_size, corpus.size());
+			if (chunk_end < corpus.size()) {
+				chunk_end = corpus.find('\n', chunk_end);
+				chunk_end = chunk_end == string_view::npos ? corpus.size() : chunk_end + 1;
+			}
+			ParseTask task([&search_server, chunk = corpus.substr(chunk_begin, chunk_end - chunk_begin), chunk_begin, format = options.format] {
+				return ParseChunk(search_server, chunk, chunk_begin, format);
+				});
+			if (!parsed_chunks.Push(task.get_future()) || !parse_tasks.Push(move(task))) {
+				break;
+			}
+			chunk_begin = chunk_end;
+		}
+		parsed_chunks.Close();
+		parse_tasks.Close();
+		});
+
+	vector<thread> parsers;
+	for (size_t i = 0; i < options.parser_count; ++i) {
+		parsers.emplace_back([&parse_tasks] {
+			ParseTask task;
+			while (parse_tasks.Pop(task)) {
+				task();
+			}
+			});
+	}
+
+	const auto stop_pipeline = [&] {
+		parsed_chunks.Close();
+		parse_tasks.Close();
+		reader.join();
+		for (thread& parser : parsers) {
+			parser.join();
+		}
+	};
+
+	// Indexer: adds the tokenized documents of every chunk as one batch, in corpus order
+	CorpusLoadStats stats;
+	try {
+		future<ParsedChunk> parsed_chunk;
+		while (parsed_chunks.Pop(parsed_chunk)) {
+			const ParsedChunk chunk = parsed_chunk.get();
+			search_server.AddDocuments(chunk.documents);
+			stats.document_count += chunk.documents.size();
+		}
+	}
+	catch (...) {
+		stop_pipeline();
+		throw;
+	}
+	stop_pipeline();
+
+	stats.byte_count = corpus.size();
+	return stats;
+}
+
+CorpusLoadStats LoadCorpusFile(SearchServer& search_server, const string& path, const CorpusLoadOptions& options) {
+	const MappedFile file(path);
+	return LoadCorpus(search_server, file.GetData(), options);
+}
\ No newline at end of file
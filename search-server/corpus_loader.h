@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "search_server.h"
+
+// One document per line, either
+//     id <TAB> status <TAB> space-separated ratings <TAB> text
+// with status one of ACTUAL, IRRELEVANT, BANNED, REMOVED, or a flat JSON object
+//     {"id": 1, "status": "ACTUAL", "ratings": [1, 2], "text": "..."}
+// Empty lines are skipped in both formats.
+enum class CorpusFormat {
+	TSV,
+	JSONL,
+};
+
+struct CorpusLoadOptions {
+	CorpusFormat format = CorpusFormat::TSV;
+	// The input is parsed in chunks of about this many bytes, split at line ends
+	size_t chunk_size = size_t{ 4 } << 20;
+	size_t parser_count = std::max(std::thread::hardware_concurrency(), 1u);
+	// Parsed chunks waiting to be indexed, bounds the memory of a fast parser
+	size_t max_pending_chunks = 8;
+};
+
+struct CorpusLoadStats {
+	size_t document_count = 0;
+	size_t byte_count = 0;
+};
+
+// Parses and tokenizes the corpus in parallel and adds its documents in file order.
+// Malformed lines throw std::invalid_argument with their byte offset, invalid words
+// as in AddDocument; the documents of the chunks before the one with the error stay added.
+CorpusLoadStats LoadCorpus(SearchServer& search_server, std::string_view corpus, const CorpusLoadOptions& options = {});
+
+// LoadCorpus over a memory-mapped file
+CorpusLoadStats LoadCorpusFile(SearchServer& search_server, const std::string& path, const CorpusLoadOptions& options = {});
\ No newline at end of file
@@ -1,24 +1,35 @@
-#pragma once
-
-#include <iostream>
-
-struct Document {
-	Document() = default;
-
-	Document(int id, double relevance, int rating);
-
-	int id = 0;
-	double relevance = 0.0;
-	int rating = 0;
-};
-
-enum class DocumentStatus {
-	ACTUAL,
-	IRRELEVANT,
-	BANNED,
-	REMOVED,
-};
-
-std::ostream& operator<<(std::ostream& out, const Document& document);
-
+#pragma once
+
+#include <iostream>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+struct Document {
+	Document() = default;
+
+	Document(int id, double relevance, int rating);
+
+	int id = 0;
+	double relevance = 0.0;
+	int rating = 0;
+	// Filled only by queries run with QueryOptions::with_matched_words
+	std::vector<std::string_view> matched_words;
+};
+
+enum class DocumentStatus {
+	ACTUAL,
+	IRRELEVANT,
+	BANNED,
+	REMOVED,
+};
+
+// Inclusive range of average document ratings
+struct RatingRange {
+	int min_rating = std::numeric_limits<int>::min();
+	int max_rating = std::numeric_limits<int>::max();
+};
+
+std::ostream& operator<<(std::ostream& out, const Document& document);
+
 void PrintDocument(const Document& document);
\ No newline at end of file
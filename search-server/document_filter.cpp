@@ -0,0 +1,55 @@
+#include "document_filter.h"
+
+#include <climits>
+
+using namespace std;
+
+DocumentFilterIndex::DocumentFilterIndex()
+	: status_masks_(static_cast<size_t>(DocumentStatus::REMOVED) + 1) {
+}
+
+void DocumentFilterIndex::Add(int slot, DocumentStatus status, int rating) {
+	const size_t index = static_cast<size_t>(slot);
+	if (ratings_.size() <= index) {
+		// Every mask spans all the slots, so that any slot can be checked against any status
+		for (auto& mask : status_masks_) {
+			mask.resize(index + 1);
+		}
+		ratings_.resize(index + 1, 0);
+	}
+	status_masks_[static_cast<size_t>(status)][index] = true;
+	ratings_[index] = rating;
+}
+
+void DocumentFilterIndex::Remove(int slot, DocumentStatus status) {
+	status_masks_[static_cast<size_t>(status)][slot] = false;
+}
+
+void DocumentFilterIndex::RemapSlots(const vector<int>& new_slots) {
+	// New slots never exceed the old ones, so the columns are compacted in place
+	size_t slot_count = 0;
+	for (size_t slot = 0; slot < new_slots.size(); ++slot) {
+		if (new_slots[slot] < 0) {
+			continue;
+		}
+		for (auto& mask : status_masks_) {
+			mask[new_slots[slot]] = mask[slot];
+		}
+		ratings_[new_slots[slot]] = ratings_[slot];
+		slot_count = new_slots[slot] + 1;
+	}
+	for (auto& mask : status_masks_) {
+		mask.resize(slot_count);
+		mask.shrink_to_fit();
+	}
+	ratings_.resize(slot_count);
+	ratings_.shrink_to_fit();
+}
+
+size_t DocumentFilterIndex::GetMemoryUsage() const {
+	size_t result = status_masks_.capacity() * sizeof(vector<bool>) + ratings_.capacity() * sizeof(int);
+	for (const auto& mask : status_masks_) {
+		result += (mask.capacity() + CHAR_BIT - 1) / CHAR_BIT;
+	}
+	return result;
+}
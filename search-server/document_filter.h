@@ -0,0 +1,41 @@
+#pragma once
+
+#include "document.h"
+#include "index_allocator.h"
+
+#include <vector>
+
+// Status bitsets and a rating column indexed by document slot. Lets status and
+// rating-range filters be checked against a posting without a documents_ lookup.
+class DocumentFilterIndex {
+public:
+	DocumentFilterIndex();
+
+	void Add(int slot, DocumentStatus status, int rating);
+	void Remove(int slot, DocumentStatus status);
+	// Moves every slot to new_slots[slot], dropping the slots mapped to -1
+	void RemapSlots(const std::vector<int>& new_slots);
+
+	int GetRating(int slot) const {
+		return ratings_[slot];
+	}
+
+	bool Matches(int slot, DocumentStatus status) const {
+		return status_masks_[static_cast<size_t>(status)][slot];
+	}
+
+	bool Matches(int slot, RatingRange rating_range) const {
+		const int rating = ratings_[slot];
+		return rating >= rating_range.min_rating && rating <= rating_range.max_rating;
+	}
+
+	bool Matches(int slot, DocumentStatus status, RatingRange rating_range) const {
+		return Matches(slot, status) && Matches(slot, rating_range);
+	}
+
+	size_t GetMemoryUsage() const;
+
+private:
+	std::vector<std::vector<bool>> status_masks_;
+	IndexVector<int> ratings_;
+};
@@ -0,0 +1,171 @@
+#include "durable_search_server.h"
+
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Makes a rename in the directory durable. Windows has no such call, its renames are journaled.
+void SyncDirectory(const string& directory) {
+#ifndef _WIN32
+	const int file = open(directory.c_str(), O_RDONLY);
+	if (file >= 0) {
+		fsync(file);
+		close(file);
+	}
+#endif
+}
+
+}  // namespace
+
+DurableSearchServer::DurableSearchServer(const string& directory, string_view stop_words_text, const SearchServerOptions& options)
+	: checkpoint_path_((filesystem::path(directory) / "checkpoint.wal").string())
+	, log_path_((filesystem::path(directory) / "log.wal").string())
+	, search_server_(stop_words_text, options) {
+	filesystem::create_directories(directory);
+
+	// A crash between writing a checkpoint and emptying the log leaves records in the
+	// log that the checkpoint already holds. Replaying all of them, with the conflicting
+	// ones skipped, still ends in the state the log ended in.
+	const auto replay = [this](const WalRecord& record) {
+		try {
+			Apply(record);
+		}
+		catch (const invalid_argument&) {
+		}
+	};
+	WriteAheadLog::Replay(checkpoint_path_, replay);
+	WriteAheadLog::Truncate(log_path_, WriteAheadLog::Replay(log_path_, replay));
+	log_ = make_shared<WriteAheadLog>(log_path_);
+}
+
+void DurableSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings, 
+									  Durability durability) {
+	shared_ptr<WriteAheadLog> log;
+	uint64_t sequence_number;
+	{
+		lock_guard lock(mutex_);
+		search_server_.AddDocument(document_id, document, status, ratings);
+		sequence_number = log_->Append({ WalRecordType::ADD_DOCUMENT, document_id, status, ratings, string(document) });
+		log = log_;
+	}
+	MakeDurable(*log, sequence_number, durability);
+}
+
+void DurableSearchServer::RemoveDocument(int document_id, Durability durability) {
+	shared_ptr<WriteAheadLog> log;
+	uint64_t sequence_number;
+	{
+		lock_guard lock(mutex_);
+		search_server_.RemoveDocument(document_id);
+		WalRecord record;
+		record.type = WalRecordType::REMOVE_DOCUMENT;
+		record.document_id = document_id;
+		sequence_number = log_->Append(record);
+		log = log_;
+	}
+	MakeDurable(*log, sequence_number, durability);
+}
+
+void DurableSearchServer::ApplyBatch(const vector<WalRecord>& batch, Durability durability) {
+	shared_ptr<WriteAheadLog> log;
+	uint64_t sequence_number = 0;
+	try {
+		lock_guard lock(mutex_);
+		log = log_;
+		for (const WalRecord& record : batch) {
+			Apply(record);
+			sequence_number = log_->Append(record);
+		}
+	}
+	catch (...) {
+		MakeDurable(*log, sequence_number, durability);
+		throw;
+	}
+	MakeDurable(*log, sequence_number, durability);
+}
+
+void DurableSearchServer::Commit() {
+	shared_ptr<WriteAheadLog> log;
+	{
+		lock_guard lock(mutex_);
+		log = log_;
+	}
+	log->Sync();
+}
+
+void DurableSearchServer::Checkpoint() {
+	lock_guard lock(mutex_);
+	// Waits for the syncs in flight too. Threads still holding the old log afterwards
+	// find all of its records synced and return without touching the file.
+	log_->Sync();
+
+	// The last ADD_DOCUMENT record of every live document, numbered across both files
+	map<int, uint64_t> live_records;
+	uint64_t record_number = 0;
+	const auto find_live_records = [&live_records, &record_number](const WalRecord& record) {
+		if (record.type == WalRecordType::ADD_DOCUMENT) {
+			live_records[record.document_id] = record_number;
+		}
+		else {
+			live_records.erase(record.document_id);
+		}
+		++record_number;
+	};
+	WriteAheadLog::Replay(checkpoint_path_, find_live_records);
+	WriteAheadLog::Replay(log_path_, find_live_records);
+
+	// Written aside and renamed, so that a crash leaves either checkpoint whole
+	const string new_checkpoint_path = checkpoint_path_ + ".new"s;
+	filesystem::remove(new_checkpoint_path);
+	{
+		WriteAheadLog new_checkpoint(new_checkpoint_path);
+		record_number = 0;
+		const auto copy_live_records = [&](const WalRecord& record) {
+			const auto live_record_it = live_records.find(record.document_id);
+			if (live_record_it != live_records.end() && live_record_it->second == record_number) {
+				new_checkpoint.Append(record);
+			}
+			++record_number;
+		};
+		WriteAheadLog::Replay(checkpoint_path_, copy_live_records);
+		WriteAheadLog::Replay(log_path_, copy_live_records);
+		new_checkpoint.Sync();
+	}
+	filesystem::rename(new_checkpoint_path, checkpoint_path_);
+	SyncDirectory(filesystem::path(checkpoint_path_).parent_path().string());
+
+	log_ = nullptr;
+	WriteAheadLog::Truncate(log_path_, 0);
+	log_ = make_shared<WriteAheadLog>(log_path_);
+}
+
+const SearchServer& DurableSearchServer::GetServer() const {
+	return search_server_;
+}
+
+void DurableSearchServer::Apply(const WalRecord& record) {
+	if (record.type == WalRecordType::ADD_DOCUMENT) {
+		search_server_.AddDocument(record.document_id, record.text, record.status, record.ratings);
+	}
+	else {
+		search_server_.RemoveDocument(record.document_id);
+	}
+}
+
+void DurableSearchServer::MakeDurable(WriteAheadLog& log, uint64_t sequence_number, Durability durability) {
+	if (durability == Durability::WRITTEN) {
+		log.Flush();
+	}
+	else if (durability == Durability::SYNCED) {
+		log.Sync(sequence_number);
+	}
+}
\ No newline at end of file
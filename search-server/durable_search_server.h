@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "search_server.h"
+#include "wal.h"
+
+enum class Durability {
+	// Kept in memory until the next Commit or synced batch
+	BUFFERED,
+	// Handed to the OS, survives a crash of the process
+	WRITTEN,
+	// On disk before the call returns
+	SYNCED,
+};
+
+// A SearchServer whose mutations are logged to a write-ahead log in a directory.
+// On construction the index is rebuilt from the last checkpoint and the log after it.
+// Mutations may come from many threads; queries go through GetServer and must not
+// run concurrently with mutations, as with a plain SearchServer.
+class DurableSearchServer {
+public:
+	DurableSearchServer(const std::string& directory, std::string_view stop_words_text, 
+						const SearchServerOptions& options = {});
+
+	void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings, 
+					 Durability durability = Durability::BUFFERED);
+	void RemoveDocument(int document_id, Durability durability = Durability::BUFFERED);
+
+	// Applies the records in order with one log write for all of them. Stops at
+	// the first invalid one, the records before it stay applied and logged.
+	void ApplyBatch(const std::vector<WalRecord>& batch, Durability durability);
+
+	// Makes every mutation so far durable. Threads committing at the same time share one fsync.
+	void Commit();
+
+	// Rewrites the checkpoint with the documents alive now and empties the log
+	void Checkpoint();
+
+	const SearchServer& GetServer() const;
+
+private:
+	const std::string checkpoint_path_;
+	const std::string log_path_;
+	SearchServer search_server_;
+	std::mutex mutex_;
+	// Replaced by Checkpoint under mutex_. Syncs after the mutex is released go through
+	// a copy taken under it, so their sequence numbers always refer to the log they came from.
+	std::shared_ptr<WriteAheadLog> log_;
+
+	void Apply(const WalRecord& record);
+	static void MakeDurable(WriteAheadLog& log, uint64_t sequence_number, Durability durability);
+};
\ No newline at end of file
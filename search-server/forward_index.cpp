@@ -0,0 +1,119 @@
+#include "forward_index.h"
+
+#include <algorithm>
+
+using namespace std;
+
+bool operator==(TermIds lhs, TermIds rhs) {
+	return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+}
+
+bool operator!=(TermIds lhs, TermIds rhs) {
+	return !(lhs == rhs);
+}
+
+double WordFrequencies::GetFrequency(string_view word) const {
+	for (const auto& [document_word, term_freq] : *this) {
+		if (document_word == word) {
+			return term_freq;
+		}
+	}
+	return 0.0;
+}
+
+bool operator==(const WordFrequencies& lhs, const WordFrequencies& rhs) {
+	if (lhs.size() != rhs.size()) {
+		return false;
+	}
+	// Term ids depend on the order words were indexed in, so the words are compared sorted
+	vector<pair<string_view, double>> lhs_words(lhs.begin(), lhs.end());
+	vector<pair<string_view, double>> rhs_words(rhs.begin(), rhs.end());
+	sort(lhs_words.begin(), lhs_words.end());
+	sort(rhs_words.begin(), rhs_words.end());
+	return lhs_words == rhs_words;
+}
+
+bool operator!=(const WordFrequencies& lhs, const WordFrequencies& rhs) {
+	return !(lhs == rhs);
+}
+
+void ForwardIndex::Add(int slot, const vector<pair<int, uint32_t>>& term_counts) {
+	if (extents_.size() <= static_cast<size_t>(slot)) {
+		extents_.resize(slot + 1);
+	}
+	extents_[slot] = { term_ids_.size(), static_cast<uint32_t>(term_counts.size()) };
+	for (const auto& [term_id, term_count] : term_counts) {
+		term_ids_.push_back(term_id);
+		term_counts_.push_back(term_count);
+	}
+}
+
+void ForwardIndex::Remove(int slot) {
+	if (static_cast<size_t>(slot) >= extents_.size() || extents_[slot].offset == NO_DOCUMENT) {
+		return;
+	}
+	removed_entry_count_ += extents_[slot].size;
+	extents_[slot] = {};
+	if (removed_entry_count_ * 2 > term_ids_.size()) {
+		Compact();
+	}
+}
+
+void ForwardIndex::RemapSlots(const vector<int>& new_slots) {
+	// Slots only move towards the front, so the extents are moved in place
+	size_t slot_count = 0;
+	for (size_t slot = 0; slot < extents_.size() && slot < new_slots.size(); ++slot) {
+		if (new_slots[slot] >= 0) {
+			extents_[new_slots[slot]] = extents_[slot];
+			slot_count = static_cast<size_t>(new_slots[slot]) + 1;
+		}
+	}
+	extents_.resize(slot_count);
+	extents_.shrink_to_fit();
+}
+
+TermIds ForwardIndex::GetTermIds(int slot) const {
+	if (slot < 0 || static_cast<size_t>(slot) >= extents_.size() || extents_[slot].offset == NO_DOCUMENT) {
+		return {};
+	}
+	const Extent& extent = extents_[slot];
+	return { term_ids_.data() + extent.offset, term_ids_.data() + extent.offset + extent.size };
+}
+
+const uint32_t* ForwardIndex::GetTermCounts(int slot) const {
+	if (slot < 0 || static_cast<size_t>(slot) >= extents_.size() || extents_[slot].offset == NO_DOCUMENT) {
+		return nullptr;
+	}
+	return term_counts_.data() + extents_[slot].offset;
+}
+
+size_t ForwardIndex::GetMemoryUsage() const {
+	return extents_.capacity() * sizeof(Extent) + term_ids_.capacity() * sizeof(int) + term_counts_.capacity() * sizeof(uint32_t);
+}
+
+void ForwardIndex::Compact() {
+	// Live entries only move towards the front when taken in buffer order
+	vector<int> slots;
+	for (size_t slot = 0; slot < extents_.size(); ++slot) {
+		if (extents_[slot].offset != NO_DOCUMENT) {
+			slots.push_back(static_cast<int>(slot));
+		}
+	}
+	sort(slots.begin(), slots.end(), [this](int lhs, int rhs) {
+		return extents_[lhs].offset < extents_[rhs].offset;
+		});
+
+	size_t kept = 0;
+	for (const int slot : slots) {
+		Extent& extent = extents_[slot];
+		copy(term_ids_.begin() + extent.offset, term_ids_.begin() + extent.offset + extent.size, term_ids_.begin() + kept);
+		copy(term_counts_.begin() + extent.offset, term_counts_.begin() + extent.offset + extent.size, term_counts_.begin() + kept);
+		extent.offset = kept;
+		kept += extent.size;
+	}
+	term_ids_.resize(kept);
+	term_counts_.resize(kept);
+	term_ids_.shrink_to_fit();
+	term_counts_.shrink_to_fit();
+	removed_entry_count_ = 0;
+}
\ No newline at end of file
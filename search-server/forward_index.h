@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Sorted term ids of a document, viewing the forward index or a vector
+class TermIds {
+public:
+	TermIds() = default;
+	TermIds(const int* first, const int* last)
+		: first_(first), last_(last) {
+	}
+	TermIds(const std::vector<int>& term_ids)
+		: first_(term_ids.data()), last_(term_ids.data() + term_ids.size()) {
+	}
+
+	const int* begin() const {
+		return first_;
+	}
+	const int* end() const {
+		return last_;
+	}
+	size_t size() const {
+		return last_ - first_;
+	}
+	bool empty() const {
+		return first_ == last_;
+	}
+	int operator[](size_t index) const {
+		return first_[index];
+	}
+
+private:
+	const int* first_ = nullptr;
+	const int* last_ = nullptr;
+};
+
+bool operator==(TermIds lhs, TermIds rhs);
+bool operator!=(TermIds lhs, TermIds rhs);
+
+// Words of a document with their term frequencies, in term id order
+class WordFrequencies {
+public:
+	class Iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = std::pair<std::string_view, double>;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = value_type;
+
+		Iterator(const int* term_id, const uint32_t* term_count, const std::string_view* term_words, double inv_word_count)
+			: term_id_(term_id), term_count_(term_count), term_words_(term_words), inv_word_count_(inv_word_count) {
+		}
+
+		value_type operator*() const {
+			return { term_words_[*term_id_], *term_count_ * inv_word_count_ };
+		}
+		Iterator& operator++() {
+			++term_id_;
+			++term_count_;
+			return *this;
+		}
+		bool operator==(const Iterator& other) const {
+			return term_id_ == other.term_id_;
+		}
+		bool operator!=(const Iterator& other) const {
+			return term_id_ != other.term_id_;
+		}
+
+	private:
+		const int* term_id_;
+		const uint32_t* term_count_;
+		const std::string_view* term_words_;
+		double inv_word_count_;
+	};
+
+	WordFrequencies() = default;
+	// term_words maps term ids to words
+	WordFrequencies(TermIds term_ids, const uint32_t* term_counts, const std::string_view* term_words, double inv_word_count)
+		: term_ids_(term_ids), term_counts_(term_counts), term_words_(term_words), inv_word_count_(inv_word_count) {
+	}
+
+	Iterator begin() const {
+		return { term_ids_.begin(), term_counts_, term_words_, inv_word_count_ };
+	}
+	Iterator end() const {
+		return { term_ids_.end(), term_counts_ + term_ids_.size(), term_words_, inv_word_count_ };
+	}
+	size_t size() const {
+		return term_ids_.size();
+	}
+	bool empty() const {
+		return term_ids_.empty();
+	}
+
+	// Frequency of the word in the document, 0 if it does not occur there
+	double GetFrequency(std::string_view word) const;
+
+private:
+	TermIds term_ids_;
+	const uint32_t* term_counts_ = nullptr;
+	const std::string_view* term_words_ = nullptr;
+	double inv_word_count_ = 0.0;
+};
+
+// Equal words with equal frequencies, regardless of term ids
+bool operator==(const WordFrequencies& lhs, const WordFrequencies& rhs);
+bool operator!=(const WordFrequencies& lhs, const WordFrequencies& rhs);
+
+// Term ids and term counts of every document, in two flat buffers shared by all
+// documents. A term frequency is its count divided by the word count of the
+// document, so the counts store it exactly in 4 bytes. Removed documents leave
+// holes that are compacted away once they outgrow the live entries.
+// Documents are found by their slot in the index, not by their id.
+// Views returned by the getters are invalidated by Add, Remove and RemapSlots.
+class ForwardIndex {
+public:
+	// term_counts holds the distinct term ids of the document in ascending order with their counts
+	void Add(int slot, const std::vector<std::pair<int, uint32_t>>& term_counts);
+	void Remove(int slot);
+
+	// new_slots[slot] is the new slot of the document, never above the old one, or -1
+	// if the document is removed. Slots keep their order.
+	void RemapSlots(const std::vector<int>& new_slots);
+
+	// Empty for unknown slots
+	TermIds GetTermIds(int slot) const;
+	// Counts parallel to GetTermIds
+	const uint32_t* GetTermCounts(int slot) const;
+
+	// Bytes held by the buffers
+	size_t GetMemoryUsage() const;
+
+private:
+	static constexpr size_t NO_DOCUMENT = SIZE_MAX;
+
+	struct Extent {
+		size_t offset = NO_DOCUMENT;
+		uint32_t size = 0;
+	};
+
+	// Indexed by slot
+	std::vector<Extent> extents_;
+	std::vector<int> term_ids_;
+	std::vector<uint32_t> term_counts_;
+	// Entries of removed documents still in the buffers
+	size_t removed_entry_count_ = 0;
+
+	void Compact();
+};
\ No newline at end of file
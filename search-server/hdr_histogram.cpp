@@ -0,0 +1,152 @@
+#include "hdr_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+int GetMostSignificantBit(uint64_t value) {
+	int bit = 0;
+	while (value >>= 1) {
+		++bit;
+	}
+	return bit;
+}
+
+}  // namespace
+
+HdrHistogram::HdrHistogram(int significant_digits, uint64_t highest_value)
+	: highest_value_(highest_value) {
+	if (significant_digits < 1 || significant_digits > 3) {
+		throw invalid_argument("Histogram precision must be from 1 to 3 significant digits"s);
+	}
+	// A power of two range is split into at least 10^digits buckets
+	uint64_t min_bucket_count = 1;
+	for (int i = 0; i < significant_digits; ++i) {
+		min_bucket_count *= 10;
+	}
+	sub_bucket_bits_ = 1;
+	while ((uint64_t{ 1 } << (sub_bucket_bits_ - 1)) < min_bucket_count) {
+		++sub_bucket_bits_;
+	}
+	counts_ = vector<atomic<uint64_t>>(GetIndex(highest_value) + 1);
+}
+
+HdrHistogram::HdrHistogram(const HdrHistogram& other)
+	: sub_bucket_bits_(other.sub_bucket_bits_)
+	, highest_value_(other.highest_value_)
+	, counts_(other.counts_.size()) {
+	Add(other);
+}
+
+HdrHistogram& HdrHistogram::operator=(const HdrHistogram& other) {
+	if (this != &other) {
+		sub_bucket_bits_ = other.sub_bucket_bits_;
+		highest_value_ = other.highest_value_;
+		counts_ = vector<atomic<uint64_t>>(other.counts_.size());
+		total_count_.store(0, memory_order_relaxed);
+		max_.store(0, memory_order_relaxed);
+		Add(other);
+	}
+	return *this;
+}
+
+void HdrHistogram::Record(uint64_t value) {
+	counts_[GetIndex(min(value, highest_value_))].fetch_add(1, memory_order_relaxed);
+	total_count_.fetch_add(1, memory_order_relaxed);
+	uint64_t max = max_.load(memory_order_relaxed);
+	while (value > max && !max_.compare_exchange_weak(max, value, memory_order_relaxed)) {
+	}
+}
+
+void HdrHistogram::Reset() {
+	for (auto& count : counts_) {
+		count.store(0, memory_order_relaxed);
+	}
+	total_count_.store(0, memory_order_relaxed);
+	max_.store(0, memory_order_relaxed);
+}
+
+void HdrHistogram::Add(const HdrHistogram& other) {
+	if (other.sub_bucket_bits_ != sub_bucket_bits_ || other.highest_value_ != highest_value_) {
+		throw invalid_argument("Histograms of different precision or range cannot be added"s);
+	}
+	for (size_t i = 0; i < counts_.size(); ++i) {
+		counts_[i].fetch_add(other.counts_[i].load(memory_order_relaxed), memory_order_relaxed);
+	}
+	total_count_.fetch_add(other.total_count_.load(memory_order_relaxed), memory_order_relaxed);
+	const uint64_t other_max = other.max_.load(memory_order_relaxed);
+	uint64_t max = max_.load(memory_order_relaxed);
+	while (other_max > max && !max_.compare_exchange_weak(max, other_max, memory_order_relaxed)) {
+	}
+}
+
+uint64_t HdrHistogram::GetTotalCount() const {
+	return total_count_.load(memory_order_relaxed);
+}
+
+uint64_t HdrHistogram::GetMax() const {
+	return max_.load(memory_order_relaxed);
+}
+
+double HdrHistogram::GetMean() const {
+	uint64_t count = 0;
+	double sum = 0.0;
+	for (size_t i = 0; i < counts_.size(); ++i) {
+		const uint64_t bucket_count = counts_[i].load(memory_order_relaxed);
+		if (bucket_count > 0) {
+			// The middle of the bucket stands for all its values
+			sum += bucket_count * (GetLowestValue(i) / 2.0 + GetHighestValue(i) / 2.0);
+			count += bucket_count;
+		}
+	}
+	return count > 0 ? sum / count : 0.0;
+}
+
+uint64_t HdrHistogram::GetValueAtQuantile(double quantile) const {
+	uint64_t count = 0;
+	for (const auto& bucket_count : counts_) {
+		count += bucket_count.load(memory_order_relaxed);
+	}
+	if (count == 0) {
+		return 0;
+	}
+	const auto rank = max<uint64_t>(static_cast<uint64_t>(ceil(min(max(quantile, 0.0), 1.0) * count)), 1);
+	uint64_t seen = 0;
+	for (size_t i = 0; i < counts_.size(); ++i) {
+		seen += counts_[i].load(memory_order_relaxed);
+		if (seen >= rank) {
+			// The last bucket also holds the values above highest_value_
+			return i + 1 < counts_.size() ? min(GetHighestValue(i), GetMax()) : GetMax();
+		}
+	}
+	return GetMax();
+}
+
+// Values below 2^sub_bucket_bits_ get a bucket each. Above that, the values with the most
+// significant bit b are split by their top sub_bucket_bits_ bits into 2^(sub_bucket_bits_ - 1)
+// buckets of width 2^(b - sub_bucket_bits_ + 1), which follow the buckets of the bit b - 1.
+size_t HdrHistogram::GetIndex(uint64_t value) const {
+	const int shift = max(GetMostSignificantBit(value) - (sub_bucket_bits_ - 1), 0);
+	const size_t half_count = size_t{ 1 } << (sub_bucket_bits_ - 1);
+	return shift * half_count + static_cast<size_t>(value >> shift);
+}
+
+uint64_t HdrHistogram::GetLowestValue(size_t index) const {
+	const size_t half_count = size_t{ 1 } << (sub_bucket_bits_ - 1);
+	if (index < 2 * half_count) {
+		return index;
+	}
+	const size_t shift = index / half_count - 1;
+	return static_cast<uint64_t>(index - shift * half_count) << shift;
+}
+
+uint64_t HdrHistogram::GetHighestValue(size_t index) const {
+	const size_t half_count = size_t{ 1 } << (sub_bucket_bits_ - 1);
+	const size_t shift = index < 2 * half_count ? 0 : index / half_count - 1;
+	return GetLowestValue(index) + ((uint64_t{ 1 } << shift) - 1);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Counts of non-negative values in log-linear buckets: every power of two range is
+// split into equal sub-buckets, so any recorded value is known to within the given
+// number of significant decimal digits, from 0 up to 2^64 - 1. Recording is lock-free.
+class HdrHistogram {
+public:
+	// significant_digits from 1 to 3. Values above highest_value share its bucket,
+	// GetMax still reports them exactly.
+	explicit HdrHistogram(int significant_digits = 2, uint64_t highest_value = UINT64_MAX);
+	HdrHistogram(const HdrHistogram& other);
+	HdrHistogram& operator=(const HdrHistogram& other);
+
+	void Record(uint64_t value);
+	void Reset();
+	// Adds the counts of a histogram with the same precision
+	void Add(const HdrHistogram& other);
+
+	uint64_t GetTotalCount() const;
+	uint64_t GetMax() const;
+	double GetMean() const;
+	// Highest value equivalent to the recorded value at the quantile, 0 if nothing was recorded
+	uint64_t GetValueAtQuantile(double quantile) const;
+
+private:
+	int sub_bucket_bits_;
+	uint64_t highest_value_;
+	std::vector<std::atomic<uint64_t>> counts_;
+	std::atomic<uint64_t> total_count_{ 0 };
+	std::atomic<uint64_t> max_{ 0 };
+
+	size_t GetIndex(uint64_t value) const;
+	uint64_t GetLowestValue(size_t index) const;
+	uint64_t GetHighestValue(size_t index) const;
+};
@@ -0,0 +1,132 @@
+#include "index_allocator.h"
+
+#include <atomic>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+atomic<HugePageMode>& ActiveHugePageMode() {
+	static atomic<HugePageMode> mode = HugePageMode::TRANSPARENT;
+	return mode;
+}
+
+size_t RoundUp(size_t size, size_t alignment) {
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+bool IsLargeBuffer(size_t size) {
+	return size >= HUGE_PAGE_MIN_BUFFER_SIZE;
+}
+
+#ifdef _WIN32
+
+// Windows has no transparent huge pages, large pages need the lock memory privilege
+void* AllocatePages(size_t size, HugePageMode mode) {
+	const size_t large_page_size = GetLargePageMinimum();
+	if (mode == HugePageMode::EXPLICIT && large_page_size > 0) {
+		void* p = VirtualAlloc(nullptr, RoundUp(size, large_page_size), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (p != nullptr) {
+			return p;
+		}
+	}
+	void* p = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	if (p == nullptr) {
+		throw bad_alloc();
+	}
+	return p;
+}
+
+void FreePages(void* p, size_t) noexcept {
+	VirtualFree(p, 0, MEM_RELEASE);
+}
+
+#elif defined(__linux__)
+
+void* AllocatePages(size_t size, HugePageMode mode) {
+#ifdef MAP_HUGETLB
+	if (mode == HugePageMode::EXPLICIT) {
+		void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (p != MAP_FAILED) {
+			return p;
+		}
+	}
+#endif
+	// Over-mapped by one huge page and trimmed, so that the buffer starts on a
+	// huge page boundary and every page of it can be collapsed into a huge one
+	void* mapping = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mapping == MAP_FAILED) {
+		throw bad_alloc();
+	}
+	char* const base = static_cast<char*>(mapping);
+	const size_t head = (HUGE_PAGE_SIZE - reinterpret_cast<uintptr_t>(base) % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+	if (head > 0) {
+		munmap(base, head);
+	}
+	munmap(base + head + size, HUGE_PAGE_SIZE - head);
+	char* const p = base + head;
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+	madvise(p, size, mode == HugePageMode::OFF ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+#endif
+	return p;
+}
+
+void FreePages(void* p, size_t size) noexcept {
+	munmap(p, size);
+}
+
+#else
+
+void* AllocatePages(size_t size, HugePageMode) {
+	return ::operator new(size);
+}
+
+void FreePages(void* p, size_t) noexcept {
+	::operator delete(p);
+}
+
+#endif
+
+}  // namespace
+
+HugePageMode GetHugePageMode() {
+	return ActiveHugePageMode().load(memory_order_relaxed);
+}
+
+void SetHugePageMode(HugePageMode mode) {
+	ActiveHugePageMode().store(mode, memory_order_relaxed);
+}
+
+string_view GetHugePageModeName(HugePageMode mode) {
+	switch (mode) {
+	case HugePageMode::EXPLICIT:
+		return "explicit";
+	case HugePageMode::TRANSPARENT:
+		return "transparent";
+	default:
+		return "off";
+	}
+}
+
+void* AllocateIndexMemory(size_t size) {
+	if (!IsLargeBuffer(size)) {
+		return ::operator new(size);
+	}
+	// The size alone tells FreeIndexMemory how the buffer was allocated, whatever the mode is by then
+	return AllocatePages(RoundUp(size, HUGE_PAGE_SIZE), GetHugePageMode());
+}
+
+void FreeIndexMemory(void* p, size_t size) noexcept {
+	if (!IsLargeBuffer(size)) {
+		::operator delete(p);
+		return;
+	}
+	FreePages(p, RoundUp(size, HUGE_PAGE_SIZE));
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+enum class HugePageMode {
+	// Large buffers are kept on ordinary pages
+	OFF,
+	// Large buffers are advised to the kernel for transparent huge pages, on Linux
+	TRANSPARENT,
+	// Large buffers are taken from the reserved huge page pool, falling back to TRANSPARENT
+	EXPLICIT,
+};
+
+constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+// Buffers of at least half a huge page are rounded up to whole huge pages
+// aligned on a huge page boundary, smaller ones come from the usual heap
+constexpr size_t HUGE_PAGE_MIN_BUFFER_SIZE = HUGE_PAGE_SIZE / 2;
+
+HugePageMode GetHugePageMode();
+
+// Applies to the buffers allocated from then on. TRANSPARENT by default.
+void SetHugePageMode(HugePageMode mode);
+
+std::string_view GetHugePageModeName(HugePageMode mode);
+
+void* AllocateIndexMemory(size_t size);
+void FreeIndexMemory(void* p, size_t size) noexcept;
+
+// Allocator of the large flat arrays of the index. Elements are left default-
+// initialized, so resizing a vector of numbers does not write its memory and the
+// pages of a fresh buffer land on the NUMA node of the thread that first writes them.
+template <typename T>
+struct IndexAllocator {
+	using value_type = T;
+
+	IndexAllocator() = default;
+
+	template <typename U>
+	IndexAllocator(const IndexAllocator<U>&) noexcept {
+	}
+
+	T* allocate(size_t n) {
+		return static_cast<T*>(AllocateIndexMemory(n * sizeof(T)));
+	}
+
+	void deallocate(T* p, size_t n) noexcept {
+		FreeIndexMemory(p, n * sizeof(T));
+	}
+
+	template <typename U>
+	void construct(U* p) noexcept(std::is_nothrow_default_constructible_v<U>) {
+		::new (static_cast<void*>(p)) U;
+	}
+
+	template <typename U, typename... Args>
+	void construct(U* p, Args&&... args) {
+		::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+	}
+
+	template <typename U>
+	bool operator==(const IndexAllocator<U>&) const noexcept {
+		return true;
+	}
+
+	template <typename U>
+	bool operator!=(const IndexAllocator<U>&) const noexcept {
+		return false;
+	}
+};
+
+template <typename T>
+using IndexVector = std::vector<T, IndexAllocator<T>>;
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Estimated bytes held by the parts of a SearchServer, counting container
+// capacities and tree node overheads
+struct IndexMemoryUsage {
+	// The indexed words, their term ids and the map nodes holding them
+	size_t dictionary = 0;
+	// Document ids, term frequencies and word positions of all the posting lists
+	size_t postings = 0;
+	size_t forward_index = 0;
+	// Ratings, statuses, lengths, slots and MinHash signatures of the documents
+	size_t metadata = 0;
+
+	size_t GetTotal() const {
+		return dictionary + postings + forward_index + metadata;
+	}
+};
+
+// Documents with from min_length to max_length non-stop words
+struct DocumentLengthBucket {
+	int min_length = 0;
+	int max_length = 0;
+	size_t document_count = 0;
+};
+
+struct IndexStatistics {
+	int document_count = 0;
+	// Indexed words found in at least one document
+	size_t term_count = 0;
+	size_t posting_count = 0;
+	int64_t total_document_length = 0;
+	IndexMemoryUsage memory_usage;
+	// Buckets of lengths 0, 1, 2-3, 4-7 and so on, up to the longest document
+	std::vector<DocumentLengthBucket> document_lengths;
+};
\ No newline at end of file
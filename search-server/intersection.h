@@ -0,0 +1,26 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+
+// lower_bound for a random access range, probing first + 1, first + 2, first + 4, ...
+// before the binary search. Costs O(log distance to the answer), which makes
+// walking a long sorted list in step with a short one cheap.
+template <typename Iterator, typename T>
+Iterator GallopLowerBound(Iterator first, Iterator last, const T& value) {
+	if (first == last || !(*first < value)) {
+		return first;
+	}
+	// Invariant: *low < value
+	Iterator low = first;
+	typename std::iterator_traits<Iterator>::difference_type step = 1;
+	while (last - low > step) {
+		const Iterator high = low + step;
+		if (!(*high < value)) {
+			return std::lower_bound(low + 1, high + 1, value);
+		}
+		low = high;
+		step *= 2;
+	}
+	return std::lower_bound(low + 1, last, value);
+}
@@ -0,0 +1,34 @@
+#include "levenshtein_automaton.h"
+
+#include <algorithm>
+
+using namespace std;
+
+LevenshteinAutomaton::LevenshteinAutomaton(string_view word, int max_distance)
+	: word_(word)
+	, max_distance_(max_distance) {
+}
+
+LevenshteinAutomaton::State LevenshteinAutomaton::Start() const {
+	State state(word_.size() + 1);
+	for (size_t i = 0; i < state.size(); ++i) {
+		state[i] = min(static_cast<int>(i), max_distance_ + 1);
+	}
+	return state;
+}
+
+LevenshteinAutomaton::State LevenshteinAutomaton::Step(const State& state, char c) const {
+	State next(state.size());
+	next[0] = min(state[0] + 1, max_distance_ + 1);
+	for (size_t i = 1; i < state.size(); ++i) {
+		const int substitution = state[i - 1] + (word_[i - 1] == c ? 0 : 1);
+		const int deletion = next[i - 1] + 1;
+		const int insertion = state[i] + 1;
+		next[i] = min({ substitution, deletion, insertion, max_distance_ + 1 });
+	}
+	return next;
+}
+
+bool LevenshteinAutomaton::CanMatch(const State& state) const {
+	return *min_element(state.begin(), state.end()) <= max_distance_;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Accepts the words within max_distance edits (insertions, deletions and
+// substitutions) of a given word. A state is a row of the edit distance table,
+// clipped at max_distance + 1, so the automaton can be run one character at a
+// time alongside a walk over a sorted dictionary.
+class LevenshteinAutomaton {
+public:
+	using State = std::vector<int>;
+
+	LevenshteinAutomaton(std::string_view word, int max_distance);
+
+	State Start() const;
+	State Step(const State& state, char c) const;
+
+	// Edit distance from the word to the characters consumed so far
+	int GetDistance(const State& state) const {
+		return state.back();
+	}
+
+	bool IsMatch(const State& state) const {
+		return state.back() <= max_distance_;
+	}
+
+	// false once no continuation of the consumed characters can match
+	bool CanMatch(const State& state) const;
+
+private:
+	std::string_view word_;
+	int max_distance_;
+};
+
+// Words of a sorted dictionary accepted by the automaton, with their distances.
+// Whole ranges sharing a prefix that cannot match are skipped with one seek.
+template <typename SortedWordMap>
+std::vector<std::pair<std::string_view, int>> FindFuzzyMatches(const SortedWordMap& dictionary, 
+															   const LevenshteinAutomaton& automaton) {
+	std::vector<std::pair<std::string_view, int>> matches;
+	// states[i] is the state after the first i characters of the current word,
+	// consecutive dictionary words share their common prefix states
+	std::vector<LevenshteinAutomaton::State> states = { automaton.Start() };
+	std::string_view previous_word;
+	std::string seek_key;
+
+	auto it = dictionary.begin();
+	while (it != dictionary.end()) {
+		const std::string_view word = it->first;
+		size_t common = 0;
+		while (common < previous_word.size() && common < word.size() && previous_word[common] == word[common]) {
+			++common;
+		}
+		states.resize(std::min(states.size(), common + 1));
+
+		size_t dead_at = word.size();
+		for (size_t i = states.size() - 1; i < word.size(); ++i) {
+			states.push_back(automaton.Step(states.back(), word[i]));
+			if (!automaton.CanMatch(states.back())) {
+				dead_at = i;
+				break;
+			}
+		}
+		previous_word = word;
+
+		if (dead_at == word.size()) {
+			if (automaton.IsMatch(states.back())) {
+				matches.push_back({ word, automaton.GetDistance(states.back()) });
+			}
+			++it;
+			continue;
+		}
+
+		// No word starting with word[0..dead_at] can match: seek past all of them
+		seek_key.assign(word.substr(0, dead_at + 1));
+		while (!seek_key.empty() && static_cast<unsigned char>(seek_key.back()) == 0xFF) {
+			seek_key.pop_back();
+		}
+		if (seek_key.empty()) {
+			break;
+		}
+		seek_key.back() = static_cast<char>(static_cast<unsigned char>(seek_key.back()) + 1);
+		it = dictionary.lower_bound(std::string_view(seek_key));
+	}
+	return matches;
+}
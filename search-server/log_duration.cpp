@@ -0,0 +1,55 @@
+#include "log_duration.h"
+
+#include <iomanip>
+
+using namespace std;
+
+namespace {
+
+array<HdrHistogram, QUERY_PHASE_COUNT>& GetQueryPhaseHistograms() {
+	static array<HdrHistogram, QUERY_PHASE_COUNT> histograms;
+	return histograms;
+}
+
+}  // namespace
+
+string_view GetQueryPhaseName(QueryPhase phase) {
+	switch (phase) {
+	case QueryPhase::PARSE:
+		return "parse"sv;
+	case QueryPhase::POSTING_FETCH:
+		return "posting fetch"sv;
+	case QueryPhase::SCORE:
+		return "score"sv;
+	case QueryPhase::MINUS_FILTER:
+		return "minus filter"sv;
+	default:
+		return "top-k"sv;
+	}
+}
+
+HdrHistogram& GetQueryPhaseHistogram(QueryPhase phase) {
+	return GetQueryPhaseHistograms()[static_cast<size_t>(phase)];
+}
+
+array<HdrHistogram, QUERY_PHASE_COUNT> GetQueryTraceSnapshot() {
+	return GetQueryPhaseHistograms();
+}
+
+void ResetQueryTrace() {
+	for (HdrHistogram& histogram : GetQueryPhaseHistograms()) {
+		histogram.Reset();
+	}
+}
+
+ostream& operator<<(ostream& out, const array<HdrHistogram, QUERY_PHASE_COUNT>& query_trace) {
+	for (size_t phase = 0; phase < QUERY_PHASE_COUNT; ++phase) {
+		const HdrHistogram& histogram = query_trace[phase];
+		out << GetQueryPhaseName(static_cast<QueryPhase>(phase)) << ": "s
+			<< histogram.GetTotalCount() << " samples, mean "s << fixed << setprecision(1) << histogram.GetMean() / 1000.0
+			<< " us, p50 "s << histogram.GetValueAtQuantile(0.5) / 1000.0
+			<< " us, p99 "s << histogram.GetValueAtQuantile(0.99) / 1000.0
+			<< " us, max "s << histogram.GetMax() / 1000.0 << " us"s << defaultfloat << '\n';
+	}
+	return out;
+}
\ No newline at end of file
@@ -1,35 +1,93 @@
-#pragma once
-
-#include <chrono>
-#include <iostream>
-
-#define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
-#define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
-#define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
-#define LOG_DURATION(x) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
-
-#define LOG_DURATION_STREAM(x, stream) LogDuration guard(x, stream)
-
-class LogDuration {
-public:
-
-	using Clock = std::chrono::steady_clock;
-
-	LogDuration(const std::string& id, std::ostream& stream)
-		: id_(id), stream_(stream) {
-	}
-
-	~LogDuration() {
-		using namespace std::chrono;
-		using namespace std::literals;
-
-		const auto end_time = Clock::now();
-		const auto dur = end_time - start_time_;
-		stream_ << id_ << ": "s << duration_cast<milliseconds>(dur).count() << " ms"s << std::endl;
-	}
-
-private:
-	const std::string id_;
-	const Clock::time_point start_time_ = Clock::now();
-	std::ostream &stream_ = std::cerr;
-};
\ No newline at end of file
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string_view>
+
+#include "hdr_histogram.h"
+
+#define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
+#define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
+#define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
+#define LOG_DURATION(x) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
+
+#define LOG_DURATION_STREAM(x, stream) LogDuration guard(x, stream)
+
+// Query phase timers are compiled in only when SEARCH_SERVER_TRACE_QUERIES is defined
+// for the whole build, otherwise the hot path carries no timing code at all
+#ifdef SEARCH_SERVER_TRACE_QUERIES
+#define TRACE_QUERY_PHASE(phase) ScopedTimer UNIQUE_VAR_NAME_PROFILE(GetQueryPhaseHistogram(phase))
+#else
+#define TRACE_QUERY_PHASE(phase)
+#endif
+
+class LogDuration {
+public:
+
+	using Clock = std::chrono::steady_clock;
+
+	LogDuration(const std::string& id, std::ostream& stream)
+		: id_(id), stream_(stream) {
+	}
+
+	~LogDuration() {
+		using namespace std::chrono;
+		using namespace std::literals;
+
+		const auto end_time = Clock::now();
+		const auto dur = end_time - start_time_;
+		stream_ << id_ << ": "s << duration_cast<milliseconds>(dur).count() << " ms"s << std::endl;
+	}
+
+private:
+	const std::string id_;
+	const Clock::time_point start_time_ = Clock::now();
+	std::ostream &stream_ = std::cerr;
+};
+
+// Records the nanoseconds of its lifetime into a histogram
+class ScopedTimer {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	explicit ScopedTimer(HdrHistogram& histogram)
+		: histogram_(histogram) {
+	}
+
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+	~ScopedTimer() {
+		histogram_.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_time_).count()));
+	}
+
+private:
+	HdrHistogram& histogram_;
+	const Clock::time_point start_time_ = Clock::now();
+};
+
+enum class QueryPhase {
+	PARSE,
+	POSTING_FETCH,
+	// Dense scoring clears the slots of minus words while scoring, so there
+	// minus filtering and collecting the candidates are counted here too
+	SCORE,
+	MINUS_FILTER,
+	TOP_K,
+};
+
+const size_t QUERY_PHASE_COUNT = static_cast<size_t>(QueryPhase::TOP_K) + 1;
+
+std::string_view GetQueryPhaseName(QueryPhase phase);
+
+// Process-wide nanosecond latencies of a phase, filled by TRACE_QUERY_PHASE
+HdrHistogram& GetQueryPhaseHistogram(QueryPhase phase);
+
+// Copies of the phase histograms, indexed by QueryPhase
+std::array<HdrHistogram, QUERY_PHASE_COUNT> GetQueryTraceSnapshot();
+void ResetQueryTrace();
+
+// One line per phase with the count and the mean, p50, p99 and max in microseconds
+std::ostream& operator<<(std::ostream& out, const std::array<HdrHistogram, QUERY_PHASE_COUNT>& query_trace);
\ No newline at end of file
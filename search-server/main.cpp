@@ -1,359 +1,1461 @@
-#include "search_server.h"
-#include "process_queries.h"
-#include "log_duration.h"
-
-#include <algorithm>
-#include <cmath>
-#include <map>
-#include <set>
-#include <string>
-#include <utility>
-#include <vector>
-#include <string_view>
-#include <execution>
-#include <iostream>
-#include <random>
-
-using namespace std;
-
-template <typename T, typename U>
-void AssertEqualImpl(const T& t, const U& u, const string& t_str, const string& u_str, const string& file,
-	const string& func, unsigned line, const string& hint) {
-	if (t != u) {
-		cout << boolalpha;
-		cout << file << "("s << line << "): "s << func << ": "s;
-		cout << "ASSERT_EQUAL("s << t_str << ", "s << u_str << ") failed: "s;
-		cout << t << " != "s << u << "."s;
-		if (!hint.empty()) {
-			cout << " Hint: "s << hint;
-		}
-		cout << endl;
-		abort();
-	}
-}
-
-#define ASSERT_EQUAL(a, b) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, ""s)
-
-#define ASSERT_EQUAL_HINT(a, b, hint) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, (hint))
-
-void AssertImpl(bool value, const string& expr_str, const string& file, const string& func, unsigned line,
-	const string& hint) {
-	if (!value) {
-		cout << file << "("s << line << "): "s << func << ": "s;
-		cout << "ASSERT("s << expr_str << ") failed."s;
-		if (!hint.empty()) {
-			cout << " Hint: "s << hint;
-		}
-		cout << endl;
-		abort();
-	}
-}
-
-#define ASSERT(expr) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, ""s)
-
-#define ASSERT_HINT(expr, hint) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, (hint))
-
-
-template <typename T>
-void RunTestImpl(T func, const string& func_name) {
-	func();
-	cerr << func_name << " OK" << endl;
-}
-
-#define RUN_TEST(func)  RunTestImpl((func), (#func))
-
-
-void TestExcludeStopWordsFromAddedDocumentContent() {
-	const int doc_id = 42;
-	const string content = "cat in the city"s;
-	const vector<int> ratings = { 1, 2, 3 };
-	{
-		SearchServer server(""sv);
-		server.AddDocument(doc_id, content, DocumentStatus::ACTUAL, ratings);
-		const auto found_docs = server.FindTopDocuments("in"s);
-		ASSERT_EQUAL(found_docs.size(), 1u);
-		const Document& doc0 = found_docs[0];
-		ASSERT_EQUAL(doc0.id, doc_id);
-	}
-
-	{
-		SearchServer server("in the"sv);
-		server.AddDocument(doc_id, content, DocumentStatus::ACTUAL, ratings);
-		ASSERT_HINT(server.FindTopDocuments("in"s).empty(), "Stop words must be excluded from documents"s);
-	}
-}
-
-void TestExcludeMinusWordsFromFoundResult() {
-	const int doc_id = 42;
-	const string content = "cat in the city"s;
-	const vector<int> ratings = { 1, 2, 3 };
-
-	SearchServer server(""sv);
-	server.AddDocument(doc_id, content, DocumentStatus::ACTUAL, ratings);
-	ASSERT_HINT(server.FindTopDocuments("-in"s).empty(), "Minus words must be excluded from result"s);
-}
-
-void TestMatchDocument() {
-	const int doc_id = 42;
-	const string content = "cat in the city"s;
-	const vector<int> ratings = { 1, 2, 3 };
-
-	// Without minus
-	{
-		SearchServer server(""sv);
-		server.AddDocument(doc_id, content, DocumentStatus::ACTUAL, ratings);
-		const auto [found_words, status] = server.MatchDocument("my cat loves the city"s, 42);
-		ASSERT_EQUAL(found_words.size(), 3);
-	}
-
-	// With minus
-	{
-		SearchServer server(""sv);
-		server.AddDocument(doc_id, content, DocumentStatus::ACTUAL, ratings);
-		const auto [found_words, status] = server.MatchDocument("my cat loves -the city"s, 42);
-		ASSERT_HINT(found_words.empty(), "Documents with minus words must be excluded from result"s);
-	}
-}
-
-void TestSortByRelevanceInFoundResult() {
-	SearchServer server(""sv);
-	server.AddDocument(0, "white cat and a fashionable collar"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
-	server.AddDocument(1, "fluffy cat fluffy tail"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
-	server.AddDocument(2, "groomed dog expressive eyes"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
-
-	const auto found_docs = server.FindTopDocuments("fluffy groomed cat"sv);
-
-	for (size_t i = 0; i + 1 < found_docs.size(); ++i) {
-		ASSERT_HINT(found_docs[i].relevance > found_docs[i + 1].relevance,
-			"Found documents must be sorted by decrease"s);
-	}
-}
-
-void TestCalculateDocumentRating() {
-	SearchServer server(""sv);
-	server.AddDocument(0, "cat in the city"sv, DocumentStatus::ACTUAL, { 1, 3, 2 });
-	const auto documents = server.FindTopDocuments("cat"sv);
-	ASSERT_EQUAL(documents[0].rating, 2);
-}
-
-void TestFindTopDocumentsWithPredicate() {
-	SearchServer server(""sv);
-	server.AddDocument(0, "cat in the city"sv, DocumentStatus::ACTUAL, { 1, 3, 2 });
-	server.AddDocument(1, "cat in the city"sv, DocumentStatus::ACTUAL, { 1, 3, 2 });
-
-	const auto found_docs = server.FindTopDocuments("in"sv,
-		[](int document_id, DocumentStatus status, int rating) { return document_id == 1; });
-	ASSERT_EQUAL(found_docs.size(), 1);
-}
-
-void TestFindTopDocumentsWithStatus() {
-	SearchServer server(""sv);
-	server.AddDocument(0, "cat in the city"sv, DocumentStatus::ACTUAL, { 1, 3, 2 });
-	server.AddDocument(1, "cat in the city"sv, DocumentStatus::BANNED, { 1, 3, 2 });
-
-	const auto found_docs = server.FindTopDocuments("in"sv, DocumentStatus::BANNED);
-	ASSERT_EQUAL_HINT(found_docs.size(), 1, "Found documents must be certain status"s);
-}
-
-bool Equal(double a, double b) {
-	const double epsilon = 1e-6;
-
-	if (a >= 1) {
-		return abs(a - b) < epsilon;
-	}
-	else {
-		return abs(a - b) < epsilon * abs(a);
-	}
-}
-
-void TestCalculateDocumentRelevance() {
-	SearchServer server(""sv);
-	server.AddDocument(0, "white cat and a fashionable collar"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
-	server.AddDocument(1, "fluffy cat fluffy tail"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
-	server.AddDocument(2, "groomed dog expressive eyes"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
-
-	const auto found_docs = server.FindTopDocuments("fluffy groomed cat"sv);
-
-	ASSERT(Equal(found_docs[0].relevance, 0.65067242136109593));
-}
-
-void SplitIntoWordsTest() {
-	
-
-	vector<string_view> str1 = SplitIntoWords("");
-	vector<string_view> str2 = SplitIntoWords(" ");
-	vector<string_view> str3 = SplitIntoWords("  ");
-	vector<string_view> str4 = SplitIntoWords(" a  ");
-	vector<string_view> str5 = SplitIntoWords("asd asd");
-	vector<string_view> str6 = SplitIntoWords(" asd   asd");
-	vector<string_view> str7 = SplitIntoWords(" asd   asd   ");
-	vector<string_view> str8 = SplitIntoWords("a");
-
-	vector<string_view> str9 = { "asd"sv, "asd"sv };
-	vector<string_view> str10 = { "a"sv };
-
-	ASSERT_HINT(str1.empty(), "");
-	ASSERT_HINT(str2.empty(), "");
-	ASSERT_HINT(str3.empty(), "");
-	ASSERT_HINT(str4 == str8, "");
-	ASSERT_HINT(str4 == str10, "");
-	ASSERT_HINT(str5 == str9, "");
-	ASSERT_HINT(str5 == str6, "");
-	ASSERT_HINT(str5 == str7, "");
-}
-
-void TestSearchServer() {
-	RUN_TEST(SplitIntoWordsTest);
-	RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
-	RUN_TEST(TestExcludeMinusWordsFromFoundResult);
-	RUN_TEST(TestMatchDocument);
-	RUN_TEST(TestSortByRelevanceInFoundResult);
-	RUN_TEST(TestCalculateDocumentRating);
-	RUN_TEST(TestFindTopDocumentsWithPredicate);
-	RUN_TEST(TestFindTopDocumentsWithStatus);
-	RUN_TEST(TestCalculateDocumentRelevance);
-
-}
-
-void SomeTest() {
-	cout << "Search server testing finished"s << endl;
-
-	SearchServer search_server("and with"s);
-
-	int id = 0;
-	for (
-		const string& text : {
-			"funny pet and nasty rat"s,
-			"funny pet with curly hair"s,
-			"funny pet and not very nasty rat"s,
-			"pet with rat and rat and rat"s,
-			"nasty rat with curly hair"s,
-		}
-		) {
-		search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, { 1, 2 });
-	}
-
-	const vector<string> queries = {
-		"nasty rat -not"s,
-		"not very funny nasty pet"s,
-		"curly hair"s
-	};
-	for (const Document& document : ProcessQueriesJoined(search_server, queries)) {
-		cout << "Document "s << document.id << " matched with relevance "s << document.relevance << endl;
-	}
-}
-
-void TaskTest() {
-	SearchServer search_server("and with"s);
-
-	int id = 0;
-	for (
-		const string& text : {
-			"white cat and yellow hat"s,
-			"curly cat curly tail"s,
-			"nasty dog with big eyes"s,
-			"nasty pigeon john"s,
-		}
-		) {
-		search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, { 1, 2 });
-	}
-
-
-	cout << "ACTUAL by default:"s << endl;
-
-	for (const Document& document : search_server.FindTopDocuments("curly nasty cat"s)) {
-		PrintDocument(document);
-	}
-	cout << "BANNED:"s << endl;
-
-	for (const Document& document : search_server.FindTopDocuments(execution::par, "curly nasty cat"s, DocumentStatus::BANNED)) {
-		PrintDocument(document);
-	}
-
-	cout << "Even ids:"s << endl;
-
-	for (const Document& document : search_server.FindTopDocuments(execution::par, "curly nasty cat"s, [](int document_id, DocumentStatus status, int rating) { return document_id % 2 == 0; })) {
-		PrintDocument(document);
-	}
-}
-
-
-
-string GenerateWord(mt19937& generator, int max_length) {
-	const int length = uniform_int_distribution(1, max_length)(generator);
-	string word;
-	word.reserve(length);
-	for (int i = 0; i < length; ++i) {
-		word.push_back(uniform_int_distribution(int('a'), int('z'))(generator));
-	}
-	return word;
-}
-
-vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
-	vector<string> words;
-	words.reserve(word_count);
-	for (int i = 0; i < word_count; ++i) {
-		words.push_back(GenerateWord(generator, max_length));
-	}
-	words.erase(unique(words.begin(), words.end()), words.end());
-	return words;
-}
-
-string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
-	string query;
-	for (int i = 0; i < word_count; ++i) {
-		if (!query.empty()) {
-			query.push_back(' ');
-		}
-		if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
-			query.push_back('-');
-		}
-		query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
-	}
-	return query;
-}
-
-vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
-	vector<string> queries;
-	queries.reserve(query_count);
-	for (int i = 0; i < query_count; ++i) {
-		queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
-	}
-	return queries;
-}
-
-template <typename ExecutionPolicy>
-void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
-	LogDuration a(string(mark), cout);
-	double total_relevance = 0;
-	for (const string_view query : queries) {
-		for (const auto& document : search_server.FindTopDocuments(policy, query)) {
-			total_relevance += document.relevance;
-		}
-	}
-	cout << total_relevance << endl;
-}
-
-#define TEST(policy) Test(#policy, search_server, queries, execution::policy)
-
-
-int main() {
-	TestSearchServer();
-	SomeTest();
-	TaskTest();
-
-	mt19937 generator;
-
-	const auto dictionary = GenerateDictionary(generator, 1000, 10);
-	const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
-
-	SearchServer search_server(dictionary[0]);
-	for (size_t i = 0; i < documents.size(); ++i) {
-		search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
-	}
-
-	const auto queries = GenerateQueries(generator, dictionary, 100, 70);
-
-	TEST(seq);
-	TEST(par);
+#include "search_server.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "corpus_loader.h"
+#include "durable_search_server.h"
+#include "log_duration.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <string_view>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+template <typename T, typename U>
+void AssertEqualImpl(const T& t, const U& u, const string& t_str, const string& u_str, const string& file,
+	const string& func, unsigned line, const string& hint) {
+	if (t != u) {
+		cout << boolalpha;
+		cout << file << "("s << line << "): "s << func << ": "s;
+		cout << "ASSERT_EQUAL("s << t_str << ", "s << u_str << ") failed: "s;
+		cout << t << " != "s << u << "."s;
+		if (!hint.empty()) {
+			cout << " Hint: "s << hint;
+		}
+		cout << endl;
+		abort();
+	}
+}
+
+#define ASSERT_EQUAL(a, b) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, ""s)
+
+#define ASSERT_EQUAL_HINT(a, b, hint) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+void AssertImpl(bool value, const string& expr_str, const string& file, const string& func, unsigned line,
+	const string& hint) {
+	if (!value) {
+		cout << file << "("s << line << "): "s << func << ": "s;
+		cout << "ASSERT("s << expr_str << ") failed."s;
+		if (!hint.empty()) {
+			cout << " Hint: "s << hint;
+		}
+		cout << endl;
+		abort();
+	}
+}
+
+#define ASSERT(expr) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, ""s)
+
+#define ASSERT_HINT(expr, hint) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+
+template <typename T>
+void RunTestImpl(T func, const string& func_name) {
+	func();
+	cerr << func_name << " OK" << endl;
+}
+
+#define RUN_TEST(func)  RunTestImpl((func), (#func))
+
+
+void TestExcludeStopWordsFromAddedDocumentContent() {
+	const int doc_id = 42;
+	const string content = "cat in the city"s;
+	const vector<int> ratings = { 1, 2, 3 };
+	{
+		SearchServer server(""sv);
+		server.AddDocument(doc_id, content, DocumentStatus::ACTUAL, ratings);
+		const auto found_docs = server.FindTopDocuments("in"s);
+		ASSERT_EQUAL(found_docs.size(), 1u);
+		const Document& doc0 = found_docs[0];
+		ASSERT_EQUAL(doc0.id, doc_id);
+	}
+
+	{
+		SearchServer server("in the"sv);
+		server.AddDocument(doc_id, content, DocumentStatus::ACTUAL, ratings);
+		ASSERT_HINT(server.FindTopDocuments("in"s).empty(), "Stop words must be excluded from documents"s);
+	}
+}
+
+void TestExcludeMinusWordsFromFoundResult() {
+	const int doc_id = 42;
+	const string content = "cat in the city"s;
+	const vector<int> ratings = { 1, 2, 3 };
+
+	SearchServer server(""sv);
+	server.AddDocument(doc_id, content, DocumentStatus::ACTUAL, ratings);
+	ASSERT_HINT(server.FindTopDocuments("-in"s).empty(), "Minus words must be excluded from result"s);
+}
+
+vector<int> FoundIds(const vector<Document>& documents) {
+	vector<int> ids;
+	for (const Document& document : documents) {
+		ids.push_back(document.id);
+	}
+	sort(ids.begin(), ids.end());
+	return ids;
+}
+
+void TestMatchDocument() {
+	const int doc_id = 42;
+	const string content = "cat in the city"s;
+	const vector<int> ratings = { 1, 2, 3 };
+
+	// Without minus
+	{
+		SearchServer server(""sv);
+		server.AddDocument(doc_id, content, DocumentStatus::ACTUAL, ratings);
+		const auto [found_words, status] = server.MatchDocument("my cat loves the city"s, 42);
+		ASSERT_EQUAL(found_words.size(), 3);
+	}
+
+	// With minus
+	{
+		SearchServer server(""sv);
+		server.AddDocument(doc_id, content, DocumentStatus::ACTUAL, ratings);
+		const auto [found_words, status] = server.MatchDocument("my cat loves -the city"s, 42);
+		ASSERT_HINT(found_words.empty(), "Documents with minus words must be excluded from result"s);
+	}
+}
+
+void TestMatchDocumentPolicies() {
+	SearchServer server("and with"sv);
+	server.AddDocument(1, "funny pet and nasty rat"sv, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(2, "funny pet with curly hair"sv, DocumentStatus::BANNED, { 1 });
+
+	for (const string& query : { "curly nasty pet hair"s, "rat funny -curly"s, "dog"s }) {
+		for (int id : { 1, 2 }) {
+			const auto [seq_words, seq_status] = server.MatchDocument(query, id);
+			const auto [par_words, par_status] = server.MatchDocument(execution::par, query, id);
+			ASSERT(seq_words == par_words);
+			ASSERT(seq_status == par_status);
+		}
+	}
+
+	const auto [words, status] = server.MatchDocument("curly nasty pet hair"s, 2);
+	ASSERT(words == vector<string_view>({ "curly"sv, "hair"sv, "pet"sv }));
+	ASSERT(status == DocumentStatus::BANNED);
+
+	const auto [minus_words, _] = server.MatchDocument("rat funny -curly"s, 2);
+	ASSERT(minus_words.empty());
+}
+
+void TestMatchDocuments() {
+	SearchServer server("and with"sv);
+	server.AddDocument(1, "funny pet and nasty rat"sv, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(2, "funny pet with curly hair"sv, DocumentStatus::BANNED, { 1 });
+	server.AddDocument(3, "curly dog"sv, DocumentStatus::ACTUAL, { 1 });
+
+	const vector<int> ids = { 3, 1, 2 };
+	for (const string& query : { "curly nasty pet hair"s, "funny -rat"s }) {
+		const auto seq_matches = server.MatchDocuments(query, ids);
+		const auto par_matches = server.MatchDocuments(execution::par, query, ids);
+		ASSERT(seq_matches == par_matches);
+		ASSERT_EQUAL(seq_matches.size(), ids.size());
+		for (size_t i = 0; i < ids.size(); ++i) {
+			ASSERT(seq_matches[i] == server.MatchDocument(query, ids[i]));
+		}
+	}
+
+	QueryOptions query_options;
+	query_options.with_matched_words = true;
+	for (const Document& document : server.FindTopDocuments(execution::par, "curly pet -rat"s, query_options, 
+		[](int, DocumentStatus, int) { return true; })) {
+		ASSERT(document.matched_words == get<0>(server.MatchDocument("curly pet -rat"s, document.id)));
+	}
+	ASSERT(server.FindTopDocuments("curly"s).front().matched_words.empty());
+
+	try {
+		server.MatchDocuments("curly"s, { 1, 4 });
+		ASSERT_HINT(false, "Unknown document id must be rejected"s);
+	}
+	catch (const invalid_argument&) {
+	}
+}
+
+void TestPreparedQueries() {
+	SearchServer server("and with"sv);
+	server.AddDocument(1, "funny pet and nasty rat"sv, DocumentStatus::ACTUAL, { 7 });
+	server.AddDocument(2, "funny pet with curly hair"sv, DocumentStatus::BANNED, { 1 });
+	server.AddDocument(3, "curly dog"sv, DocumentStatus::ACTUAL, { 4 });
+
+	const string raw_query = "curly pet -rat"s;
+	vector<SearchServer::PreparedQuery> prepared_queries;
+	{
+		// Moved after preparing and outliving the query text
+		string text = raw_query;
+		prepared_queries.push_back(server.PrepareQuery(text));
+	}
+	const auto& query = prepared_queries.front();
+
+	const auto same_documents = [](const vector<Document>& lhs, const vector<Document>& rhs) {
+		return lhs.size() == rhs.size() && equal(lhs.begin(), lhs.end(), rhs.begin(), [](const Document& l, const Document& r) {
+			return l.id == r.id && abs(l.relevance - r.relevance) < 1e-12 && l.rating == r.rating;
+			});
+	};
+	ASSERT(same_documents(server.FindTopDocuments(query), server.FindTopDocuments(raw_query)));
+	ASSERT(same_documents(server.FindTopDocuments(execution::par, query), server.FindTopDocuments(raw_query)));
+	ASSERT(same_documents(server.FindTopDocuments(query, DocumentStatus::BANNED), server.FindTopDocuments(raw_query, DocumentStatus::BANNED)));
+	ASSERT(same_documents(server.FindTopDocuments(execution::seq, query, [](int, DocumentStatus, int rating) { return rating > 1; }), 
+						  server.FindTopDocuments(raw_query, [](int, DocumentStatus, int rating) { return rating > 1; })));
+	for (const int id : { 1, 2, 3 }) {
+		ASSERT(server.MatchDocument(query, id) == server.MatchDocument(raw_query, id));
+	}
+	ASSERT(server.MatchDocuments(execution::par, query, { 3, 2 }) == server.MatchDocuments(raw_query, { 3, 2 }));
+
+	// Postings and IDFs follow the documents added and removed after preparing
+	server.AddDocument(4, "curly curly pet"sv, DocumentStatus::ACTUAL, { 2 });
+	ASSERT(same_documents(server.FindTopDocuments(query), server.FindTopDocuments(raw_query)));
+	server.RemoveDocument(3);
+	ASSERT(same_documents(server.FindTopDocuments(query), server.FindTopDocuments(raw_query)));
+	ASSERT(FoundIds(server.FindTopDocuments(query)) == vector<int>({ 4 }));
+}
+
+void TestRemoveDocuments() {
+	SearchServer server("and"sv, SearchServerOptions{ RankingModel::TF_IDF, 1.2, 0.75, true });
+	SearchServer expected("and"sv, SearchServerOptions{ RankingModel::TF_IDF, 1.2, 0.75, true });
+	for (int id = 0; id < 10; ++id) {
+		const string text = "cat and dog "s + (id % 2 ? "bird"s : "fish dog"s);
+		server.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+		if (id % 3 != 0) {
+			expected.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+		}
+	}
+	server.RemoveDocuments({ 9, 0, 3, 6, 3 });
+	ASSERT_EQUAL(server.GetDocumentCount(), expected.GetDocumentCount());
+
+	for (const string& query : { "cat"s, "fish -bird"s, "\"dog fish\""s, "dog NEAR/1 cat"s }) {
+		QueryOptions options;
+		options.limit = 100;
+		ASSERT(FoundIds(server.FindTopDocuments(query, options)) == FoundIds(expected.FindTopDocuments(query, options)));
+	}
+
+	{
+		SearchServer par_server("and"sv);
+		SearchServer par_expected("and"sv);
+		for (int id = 0; id < 2000; ++id) {
+			const string text = "word"s + to_string(id % 17) + " word"s + to_string(id % 101) + " common"s;
+			par_server.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+			if (id % 3 != 0) {
+				par_expected.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+			}
+		}
+		vector<int> removed_ids;
+		for (int id = 1998; id >= 0; id -= 3) {
+			removed_ids.push_back(id);
+		}
+		par_server.RemoveDocuments(execution::par, removed_ids);
+		ASSERT_EQUAL(par_server.GetDocumentCount(), par_expected.GetDocumentCount());
+		ASSERT_EQUAL(par_server.GetIndexStatistics().posting_count, par_expected.GetIndexStatistics().posting_count);
+		ASSERT_EQUAL(par_server.GetIndexStatistics().term_count, par_expected.GetIndexStatistics().term_count);
+		for (const string& query : { "common"s, "word5 -word7"s, "word16 word100"s }) {
+			QueryOptions options;
+			options.limit = 2000;
+			ASSERT(FoundIds(par_server.FindTopDocuments(query, options)) == FoundIds(par_expected.FindTopDocuments(query, options)));
+		}
+	}
+
+	try {
+		server.RemoveDocuments({ 1, 3 });
+		ASSERT_HINT(false, "Unknown document id must be rejected"s);
+	}
+	catch (const invalid_argument&) {
+	}
+	ASSERT_EQUAL(server.GetDocumentCount(), expected.GetDocumentCount());
+}
+
+void TestRemoveDuplicates() {
+	SearchServer server("and with"sv);
+	server.AddDocument(1, "funny pet and nasty rat"sv, DocumentStatus::ACTUAL, { 7 });
+	server.AddDocument(2, "funny pet with curly hair"sv, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(3, "funny pet with curly hair"sv, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(4, "funny pet and curly hair"sv, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(5, "funny funny pet and nasty nasty rat"sv, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(6, "funny pet and not very nasty rat"sv, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(7, "very nasty rat and not very funny pet"sv, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(8, "pet with rat and rat and rat"sv, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(9, "nasty rat with curly hair"sv, DocumentStatus::ACTUAL, { 1 });
+
+	ASSERT(RemoveDuplicates(server) == vector<int>({ 3, 4, 5, 7 }));
+	ASSERT_EQUAL(server.GetDocumentCount(), 5);
+	ASSERT(vector<int>(server.begin(), server.end()) == vector<int>({ 1, 2, 6, 8, 9 }));
+}
+
+void TestFindNearDuplicates() {
+	SearchServerOptions options;
+	options.minhash_signature_size = 128;
+	SearchServer server("and with"sv, options);
+	const string spam = "buy cheap pills online now best price fast delivery"s;
+	server.AddDocument(1, spam, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(2, "funny pet with curly hair"sv, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(3, spam + " today"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(4, "nasty rat and angry dog"sv, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(5, "buy cheap pills online now best price fast shipping"sv, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(6, "funny pet and curly hair"sv, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(7, "buy cheap cars"sv, DocumentStatus::ACTUAL, { 1 });
+
+	ASSERT_EQUAL(server.GetMinHashSignature(1).size(), 128u);
+	ASSERT(server.GetMinHashSignature(2) == server.GetMinHashSignature(6));
+	ASSERT(FindNearDuplicates(server, 0.75) == vector<vector<int>>({ { 1, 3, 5 }, { 2, 6 } }));
+	ASSERT(FindNearDuplicates(server, 1.0) == vector<vector<int>>({ { 2, 6 } }));
+	ASSERT_EQUAL(server.GetDocumentCount(), 7);
+
+	server.RemoveDocument(6);
+	ASSERT(server.GetMinHashSignature(6).empty());
+	ASSERT(FindNearDuplicates(server, 0.75) == vector<vector<int>>({ { 1, 3, 5 } }));
+
+	// 1 and 2 are only similar through 3, which comes after both of them. 1 has the
+	// signature of 3, so 3 meets 2 only in the buckets of 1.
+	SearchServer chain_server(""sv, options);
+	string text;
+	for (int i = 0; i < 200; ++i) {
+		text += "w"s + to_string(i) + " "s;
+	}
+	chain_server.AddDocument(1, text + "first"s, DocumentStatus::ACTUAL, { 1 });
+	chain_server.AddDocument(2, text + "second"s, DocumentStatus::ACTUAL, { 1 });
+	chain_server.AddDocument(3, text, DocumentStatus::ACTUAL, { 1 });
+	ASSERT(chain_server.GetMinHashSignature(1) == chain_server.GetMinHashSignature(3));
+	ASSERT(FindNearDuplicates(chain_server, 0.993) == vector<vector<int>>({ { 1, 2, 3 } }));
+
+	try {
+		FindNearDuplicates(SearchServer(""sv), 0.5);
+		ASSERT_HINT(false, "Servers without signatures must be rejected"s);
+	}
+	catch (const invalid_argument&) {
+	}
+}
+
+void TestConcurrentMap() {
+	const int key_count = 10000;
+	vector<int> keys(key_count * 4);
+	for (size_t i = 0; i < keys.size(); ++i) {
+		keys[i] = static_cast<int>(i % key_count) - key_count / 2;
+	}
+
+	ConcurrentMap<int, int> counts(16);
+	for_each(execution::par, keys.begin(), keys.end(), [&counts](int key) {
+		counts.Add(key, 1);
+		});
+	++counts[0].ref_to_value;
+	ASSERT_EQUAL(counts.size(), static_cast<size_t>(key_count));
+
+	// Erasing shifts entries back along their probe sequences, they must all stay reachable
+	for (int key = -key_count / 2; key < key_count / 2; key += 3) {
+		counts.erase(key);
+	}
+	counts.erase(key_count);
+
+	map<int, int> expected;
+	for (int key = -key_count / 2; key < key_count / 2; ++key) {
+		if ((key + key_count / 2) % 3 != 0) {
+			expected[key] = key == 0 ? 5 : 4;
+		}
+	}
+	ASSERT(counts.BuildOrdinaryMap() == expected);
+	auto entries = counts.BuildVector();
+	sort(entries.begin(), entries.end());
+	const vector<pair<int, int>> expected_entries(expected.begin(), expected.end());
+	ASSERT(entries == expected_entries);
+
+	size_t iterated = 0;
+	for (const auto [key, count] : counts) {
+		ASSERT_EQUAL(count, expected.at(key));
+		++iterated;
+	}
+	ASSERT_EQUAL(iterated, expected.size());
+
+	atomic<int> total = 0;
+	counts.ForEach(execution::par, [&total](int, int count) {
+		total += count;
+		});
+	ASSERT_EQUAL(total.load(), static_cast<int>(expected.size()) * 4 + 1);
+}
+
+void TestIndexAllocator() {
+	const size_t large_size = HUGE_PAGE_MIN_BUFFER_SIZE / sizeof(int) + 1;
+	for (HugePageMode mode : { HugePageMode::OFF, HugePageMode::TRANSPARENT, HugePageMode::EXPLICIT }) {
+		SetHugePageMode(mode);
+		IndexVector<int> small(100, 1);
+		IndexVector<int> large(large_size, 1);
+#ifdef __linux__
+		ASSERT_HINT(reinterpret_cast<uintptr_t>(large.data()) % HUGE_PAGE_SIZE == 0, string(GetHugePageModeName(mode)));
+#endif
+		// Freed under another mode than the one it was allocated under
+		SetHugePageMode(HugePageMode::OFF);
+		large.push_back(2);
+		ASSERT_EQUAL(accumulate(small.begin(), small.end(), 0), 100);
+		ASSERT_EQUAL(accumulate(large.begin(), large.end(), 0), static_cast<int>(large_size) + 2);
+	}
+
+	const string query = "cat dog"s;
+	vector<vector<Document>> found_docs;
+	for (HugePageMode mode : { HugePageMode::OFF, HugePageMode::TRANSPARENT }) {
+		SetHugePageMode(mode);
+		// Long enough for the postings of "cat" to take whole huge pages
+		SearchServer server(""sv);
+		for (int id = 0; id < 150'000; ++id) {
+			server.AddDocument(id, id % 3 == 0 ? "cat dog"s : "cat"s, DocumentStatus::ACTUAL, { id % 10 });
+		}
+		found_docs.push_back(server.FindTopDocuments(query));
+	}
+	SetHugePageMode(HugePageMode::TRANSPARENT);
+	ASSERT_EQUAL(found_docs[0].size(), found_docs[1].size());
+	for (size_t i = 0; i < found_docs[0].size(); ++i) {
+		ASSERT_EQUAL(found_docs[0][i].id, found_docs[1][i].id);
+		ASSERT(found_docs[0][i].relevance == found_docs[1][i].relevance);
+	}
+}
+
+void TestNumaPlacement() {
+	const NumaTopology topology = DetectNumaTopology();
+	ASSERT(!topology.node_cpus.empty() && !topology.node_cpus[0].empty());
+
+	// Long enough for some posting lists to be placed, with every fourth id missing
+	SearchServer server("and with"sv);
+	const vector<string> words = { "funny"s, "pet"s, "nasty"s, "rat"s, "curly"s, "hair"s, "dog"s };
+	for (int id = 0; id < 4 * static_cast<int>(NUMA_PLACEMENT_MIN_POSTINGS); ++id) {
+		if (id % 4 == 3) {
+			continue;
+		}
+		string text = words[id % words.size()] + " "s + words[id % 5] + " "s + words[(id / 7) % words.size()];
+		if (id % 1000 == 0) {
+			text += " sparrow"s;
+		}
+		server.AddDocument(id, text, id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { id % 10 });
+	}
+	ASSERT(server.GetLongestPostingLists(1).at(0).second >= NUMA_PLACEMENT_MIN_POSTINGS);
+
+	const auto assert_same_results = [&server](const NumaExecutor& executor) {
+		QueryOptions options;
+		options.with_matched_words = true;
+		for (const string& raw_query : { "funny pet"s, "curly -dog"s, "sparrow hair"s, "sparrow -funny"s, "owl"s }) {
+			const auto query = server.PrepareQuery(raw_query, options);
+			for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+				const auto expected = server.FindTopDocuments(query, status);
+				const auto found = server.FindTopDocuments(NumaPolicy{ &executor }, query, status);
+				ASSERT_EQUAL_HINT(found.size(), expected.size(), raw_query);
+				for (size_t i = 0; i < found.size(); ++i) {
+					ASSERT_EQUAL_HINT(found[i].id, expected[i].id, raw_query);
+					ASSERT_HINT(found[i].relevance == expected[i].relevance, raw_query);
+					ASSERT_HINT(found[i].matched_words == expected[i].matched_words, raw_query);
+				}
+			}
+
+			// Raw queries are parsed and matched on the calling thread
+			const auto expected = server.FindTopDocuments(raw_query);
+			const auto found = server.FindTopDocuments(NumaPolicy{ &executor }, raw_query);
+			ASSERT_EQUAL_HINT(found.size(), expected.size(), raw_query);
+			vector<int> found_ids;
+			for (size_t i = 0; i < found.size(); ++i) {
+				ASSERT_EQUAL_HINT(found[i].id, expected[i].id, raw_query);
+				found_ids.push_back(found[i].id);
+			}
+			ASSERT_HINT(server.MatchDocuments(NumaPolicy{ &executor }, raw_query, found_ids) == server.MatchDocuments(raw_query, found_ids), 
+						raw_query);
+		}
+	};
+
+	NumaExecutor executor(SimulateNumaTopology(3, 2));
+	ASSERT_EQUAL(executor.GetNodeCount(), 3u);
+	assert_same_results(executor);
+	server.PlaceOnNumaNodes(executor);
+	assert_same_results(executor);
+	server.RemoveDocument(0);
+	server.AddDocument(2'000'000, "funny sparrow"sv, DocumentStatus::ACTUAL, { 1 });
+	assert_same_results(executor);
+
+	// A server placed for more nodes than an executor has still finds everything
+	NumaExecutor single_node_executor(topology, 1);
+	assert_same_results(single_node_executor);
+}
+
+void TestIndexStatistics() {
+	SearchServerOptions options;
+	options.store_word_positions = true;
+	options.minhash_signature_size = 16;
+	SearchServer server("and"s, options);
+	ASSERT_EQUAL(server.GetIndexStatistics().posting_count, 0u);
+	ASSERT(server.GetIndexStatistics().document_lengths.empty());
+
+	server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(2, "cat and dog"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(3, "cat dog bird bird"s, DocumentStatus::BANNED, { 1 });
+	server.AddDocument(4, "a very long and rather wordy document about a cat"s, DocumentStatus::ACTUAL, { 1 });
+
+	IndexStatistics statistics = server.GetIndexStatistics();
+	ASSERT_EQUAL(statistics.document_count, 4);
+	ASSERT_EQUAL(statistics.term_count, 10u);
+	ASSERT_EQUAL(statistics.posting_count, 14u);
+	ASSERT_EQUAL(statistics.total_document_length, 16);
+	ASSERT(statistics.memory_usage.dictionary > 0 && statistics.memory_usage.postings > 0);
+	ASSERT(statistics.memory_usage.forward_index > 0 && statistics.memory_usage.metadata > 0);
+	const vector<tuple<int, int, size_t>> expected_lengths = { { 0, 0, 0 }, { 1, 1, 1 }, { 2, 3, 1 }, { 4, 7, 1 }, { 8, 15, 1 } };
+	ASSERT_EQUAL(statistics.document_lengths.size(), expected_lengths.size());
+	for (size_t i = 0; i < expected_lengths.size(); ++i) {
+		const DocumentLengthBucket& bucket = statistics.document_lengths[i];
+		ASSERT(tuple(bucket.min_length, bucket.max_length, bucket.document_count) == expected_lengths[i]);
+	}
+
+	const vector<pair<string_view, size_t>> expected_longest = { { "cat"sv, 4 }, { "dog"sv, 2 } };
+	ASSERT(server.GetLongestPostingLists(2) == expected_longest);
+	ASSERT_EQUAL(server.GetLongestPostingLists(100).size(), 10u);
+
+	server.RemoveDocument(execution::par, 4);
+	server.RemoveDocuments({ 1 });
+	statistics = server.GetIndexStatistics();
+	ASSERT_EQUAL(statistics.term_count, 3u);
+	ASSERT_EQUAL(statistics.posting_count, 5u);
+	ASSERT_EQUAL(statistics.total_document_length, 6);
+	ASSERT_EQUAL(statistics.document_lengths.size(), 4u);
+	ASSERT_EQUAL(statistics.document_lengths[1].document_count, 0u);
+
+	// The counters are those of an index built from the remaining documents alone
+	SearchServer rebuilt("and"s, options);
+	rebuilt.AddDocument(2, "cat and dog"s, DocumentStatus::ACTUAL, { 1 });
+	rebuilt.AddDocument(3, "cat dog bird bird"s, DocumentStatus::BANNED, { 1 });
+	const IndexStatistics rebuilt_statistics = rebuilt.GetIndexStatistics();
+	ASSERT_EQUAL(statistics.term_count, rebuilt_statistics.term_count);
+	ASSERT_EQUAL(statistics.posting_count, rebuilt_statistics.posting_count);
+	ASSERT(statistics.memory_usage.dictionary > rebuilt_statistics.memory_usage.dictionary);
+}
+
+void TestSparseDocumentIds() {
+	SearchServer server("and"s);
+	server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(2'000'000'000, "curly dog"s, DocumentStatus::ACTUAL, { 2 });
+	// Documents are indexed by slot, so far apart ids cost no more than close ones
+	const IndexMemoryUsage memory_usage = server.GetIndexStatistics().memory_usage;
+	ASSERT(memory_usage.forward_index < 1024);
+	ASSERT(memory_usage.metadata < 1024);
+	ASSERT_EQUAL(server.FindTopDocuments("curly"s, DocumentStatus::ACTUAL).size(), 2u);
+	ASSERT_EQUAL(server.FindTopDocuments("curly"s, DocumentStatus::BANNED).size(), 0u);
+	ASSERT_EQUAL(server.GetWordFrequencies(2'000'000'000).GetFrequency("dog"sv), 0.5);
+	ASSERT_EQUAL(server.FindTopDocuments("dog"s).at(0).id, 2'000'000'000);
+
+	// Removing most documents renumbers the slots of the rest
+	for (int id = 2; id < 50; ++id) {
+		server.AddDocument(id, id % 2 == 0 ? "fluffy dog and collar"s : "curly cat and tail"s, DocumentStatus::ACTUAL, { id });
+	}
+	vector<int> removed_ids;
+	for (int id = 2; id < 40; ++id) {
+		removed_ids.push_back(id);
+	}
+	server.RemoveDocuments(removed_ids);
+	server.RemoveDocument(1);
+	server.AddDocument(7, "fluffy cat"s, DocumentStatus::ACTUAL, { 7 });
+
+	SearchServer rebuilt("and"s);
+	rebuilt.AddDocument(2'000'000'000, "curly dog"s, DocumentStatus::ACTUAL, { 2 });
+	for (int id = 40; id < 50; ++id) {
+		rebuilt.AddDocument(id, id % 2 == 0 ? "fluffy dog and collar"s : "curly cat and tail"s, DocumentStatus::ACTUAL, { id });
+	}
+	rebuilt.AddDocument(7, "fluffy cat"s, DocumentStatus::ACTUAL, { 7 });
+	ASSERT_EQUAL(server.GetDocumentCount(), rebuilt.GetDocumentCount());
+	for (const int id : rebuilt) {
+		ASSERT(server.GetWordFrequencies(id) == rebuilt.GetWordFrequencies(id));
+		ASSERT(server.MatchDocument("curly -collar"s, id) == rebuilt.MatchDocument("curly -collar"s, id));
+	}
+	for (const string& query : { "curly cat"s, "fluffy -cat"s, "dog collar tail"s }) {
+		const auto found = server.FindTopDocuments(query);
+		const auto expected_found = rebuilt.FindTopDocuments(query);
+		ASSERT_EQUAL(found.size(), expected_found.size());
+		for (size_t i = 0; i < found.size(); ++i) {
+			ASSERT_EQUAL(found[i].id, expected_found[i].id);
+			ASSERT(abs(found[i].relevance - expected_found[i].relevance) < 1e-9);
+		}
+	}
+}
+
+void TestRequestQueue() {
+	SearchServer server("and in at"sv);
+	server.AddDocument(1, "curly cat curly tail"sv, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	server.AddDocument(2, "curly dog and fancy collar"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
+	RequestQueue request_queue(server);
+
+	for (int i = 0; i < 1439; ++i) {
+		request_queue.AddFindRequest("empty request"s);
+	}
+	request_queue.AddFindRequest("curly dog"s);
+	ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1439);
+	request_queue.AddFindRequest("big collar"s);
+	ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1438);
+
+	const vector<string> queries(500, "sparrow"s);
+	ProcessQueries(request_queue, queries);
+	ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1438);
+
+	const auto stats = request_queue.GetStats(chrono::minutes(1));
+	ASSERT_EQUAL(stats.query_count, 1441u + 500u);
+	ASSERT_EQUAL(stats.zero_result_count, 1439u + 500u);
+	ASSERT_EQUAL(stats.result_count, 3u);
+}
+
+void TestProcessQueriesJoined() {
+	SearchServer server("and with"sv);
+	server.AddDocument(1, "funny pet and nasty rat"sv, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	server.AddDocument(2, "funny pet with curly hair"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
+	server.AddDocument(3, "nasty rat with curly hair"sv, DocumentStatus::ACTUAL, { 1, 2, 8 });
+	const vector<string> queries = { "nasty rat -not"s, "sparrow"s, "curly hair"s, "funny"s };
+
+	const auto expected = ProcessQueries(server, queries);
+	const Docs joined = ProcessQueriesJoined(server, queries);
+	ASSERT_EQUAL(joined.GetQueryCount(), queries.size());
+	vector<int> expected_ids;
+	for (size_t i = 0; i < queries.size(); ++i) {
+		ASSERT_EQUAL(joined.GetQueryResults(i).size(), expected[i].size());
+		for (const Document& document : expected[i]) {
+			expected_ids.push_back(document.id);
+		}
+	}
+	vector<int> joined_ids;
+	for (const Document& document : joined) {
+		joined_ids.push_back(document.id);
+	}
+	ASSERT(joined_ids == expected_ids);
+}
+
+void TestQueryStats() {
+	using namespace chrono;
+	QueryStats stats(seconds(1), 10);
+	const auto start = QueryStats::Clock::now();
+
+	stats.Record(microseconds(100), 0, start);
+	stats.Record(microseconds(300), 5, start + milliseconds(500));
+	stats.Record(microseconds(3000), 5, start + seconds(3));
+
+	auto snapshot = stats.GetSnapshot(seconds(10), start + seconds(3));
+	ASSERT_EQUAL(snapshot.query_count, 3u);
+	ASSERT_EQUAL(snapshot.zero_result_count, 1u);
+	ASSERT(abs(snapshot.GetAverageResultCount() - 10.0 / 3) < 1e-9);
+	ASSERT(abs(snapshot.GetQueriesPerSecond() - 0.3) < 1e-9);
+	ASSERT(snapshot.GetLatencyQuantile(0.5) >= microseconds(300) && snapshot.GetLatencyQuantile(0.5) < microseconds(320));
+	ASSERT(snapshot.GetLatencyQuantile(1.0) == microseconds(3000));
+	ASSERT_EQUAL(snapshot.latency_histogram.GetTotalCount(), 3u);
+
+	// Only the last bucket is in a one second window
+	snapshot = stats.GetSnapshot(seconds(1), start + seconds(3));
+	ASSERT_EQUAL(snapshot.query_count, 1u);
+
+	// The first bucket is reused ten seconds later and forgets its old queries
+	stats.Record(microseconds(10), 1, start + seconds(10));
+	snapshot = stats.GetSnapshot(seconds(10), start + seconds(10));
+	ASSERT_EQUAL(snapshot.query_count, 2u);
+	ASSERT_EQUAL(snapshot.zero_result_count, 0u);
+}
+
+void TestHdrHistogram() {
+	HdrHistogram histogram(2);
+	for (uint64_t value = 1; value <= 10000; ++value) {
+		histogram.Record(value * 1000);
+	}
+	ASSERT_EQUAL(histogram.GetTotalCount(), 10000u);
+	ASSERT_EQUAL(histogram.GetMax(), 10000000u);
+	for (const double quantile : { 0.01, 0.5, 0.9, 0.99, 0.999 }) {
+		const double expected = quantile * 10000000;
+		ASSERT(abs(histogram.GetValueAtQuantile(quantile) - expected) <= expected / 100);
+	}
+	ASSERT_EQUAL(histogram.GetValueAtQuantile(1.0), 10000000u);
+	ASSERT(abs(histogram.GetMean() - 5000500.0) <= 5000500.0 / 100);
+
+	// Small values are exact, huge ones still have a bucket
+	HdrHistogram small_values(1);
+	small_values.Record(0);
+	small_values.Record(3);
+	small_values.Record(UINT64_MAX);
+	ASSERT_EQUAL(small_values.GetValueAtQuantile(0.3), 0u);
+	ASSERT_EQUAL(small_values.GetValueAtQuantile(0.6), 3u);
+	ASSERT_EQUAL(small_values.GetValueAtQuantile(1.0), UINT64_MAX);
+
+	// Values above the highest one share its bucket and keep their exact maximum
+	HdrHistogram capped(2, 1000);
+	capped.Record(10);
+	capped.Record(5000);
+	ASSERT_EQUAL(capped.GetValueAtQuantile(0.5), 10u);
+	ASSERT_EQUAL(capped.GetValueAtQuantile(1.0), 5000u);
+
+	HdrHistogram merged = histogram;
+	merged.Add(histogram);
+	ASSERT_EQUAL(merged.GetTotalCount(), 20000u);
+	ASSERT_EQUAL(merged.GetValueAtQuantile(0.5), histogram.GetValueAtQuantile(0.5));
+	merged.Reset();
+	ASSERT_EQUAL(merged.GetTotalCount(), 0u);
+	ASSERT_EQUAL(merged.GetValueAtQuantile(0.5), 0u);
+
+	{
+		ScopedTimer timer(merged);
+	}
+	ASSERT_EQUAL(merged.GetTotalCount(), 1u);
+}
+
+void TestLoadCorpus() {
+	const string tsv_corpus = 
+		"1\tACTUAL\t1 2 3\tfunny pet and nasty rat\n"
+		"\n"
+		"2\tBANNED\t\tfunny pet with curly hair\r\n"
+		"3\tACTUAL\t-4\tcurly dog\n"s;
+	const string jsonl_corpus = 
+		"{\"id\": 1, \"status\": \"ACTUAL\", \"ratings\": [1, 2, 3], \"text\": \"funny pet and nasty rat\"}\n"
+		"{\"text\": \"funny pet with \\u0063urly hair\", \"id\": 2, \"status\": \"BANNED\", \"source\": {\"n\": [1]}}\n"
+		"{ \"id\" : 3, \"ratings\" : [ -4 ], \"text\" : \"curly \\u0064og\" }"s;
+
+	SearchServer expected("and with"sv);
+	expected.AddDocument(1, "funny pet and nasty rat"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
+	expected.AddDocument(2, "funny pet with curly hair"sv, DocumentStatus::BANNED, {});
+	expected.AddDocument(3, "curly dog"sv, DocumentStatus::ACTUAL, { -4 });
+
+	const auto assert_loaded = [&expected](const SearchServer& server) {
+		ASSERT_EQUAL(server.GetDocumentCount(), expected.GetDocumentCount());
+		for (const int id : { 1, 2, 3 }) {
+			ASSERT(server.GetWordFrequencies(id) == expected.GetWordFrequencies(id));
+			ASSERT(server.MatchDocument("funny curly rat"s, id) == expected.MatchDocument("funny curly rat"s, id));
+		}
+		for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+			const auto found = server.FindTopDocuments("curly pet"s, status);
+			const auto expected_found = expected.FindTopDocuments("curly pet"s, status);
+			ASSERT_EQUAL(found.size(), expected_found.size());
+			for (size_t i = 0; i < found.size(); ++i) {
+				ASSERT_EQUAL(found[i].id, expected_found[i].id);
+				ASSERT_EQUAL(found[i].rating, expected_found[i].rating);
+			}
+		}
+	};
+
+	CorpusLoadOptions options;
+	// Tiny chunks, so that every line is parsed as a chunk of its own
+	options.chunk_size = 1;
+	options.parser_count = 3;
+	options.max_pending_chunks = 2;
+	{
+		SearchServer server("and with"sv);
+		ASSERT_EQUAL(LoadCorpus(server, tsv_corpus, options).document_count, 3u);
+		assert_loaded(server);
+	}
+	{
+		SearchServer server("and with"sv);
+		options.format = CorpusFormat::JSONL;
+		ASSERT_EQUAL(LoadCorpus(server, jsonl_corpus, options).document_count, 3u);
+		assert_loaded(server);
+	}
+	{
+		const auto path = filesystem::temp_directory_path() / "search_server_corpus_test.tsv";
+		ofstream(path, ios::binary) << tsv_corpus;
+		SearchServer server("and with"sv);
+		const auto stats = LoadCorpusFile(server, path.string());
+		filesystem::remove(path);
+		ASSERT_EQUAL(stats.byte_count, tsv_corpus.size());
+		assert_loaded(server);
+	}
+
+	// Documents are tokenized ahead of AddDocuments and index the same
+	{
+		SearchServer server("and with"sv);
+		const string text = "funny pet and nasty rat"s;
+		vector<TokenizedDocument> documents(1);
+		documents[0].id = 1;
+		documents[0].ratings = { 1, 2, 3 };
+		server.TokenizeDocument(text, documents[0]);
+		ASSERT_EQUAL(documents[0].words.size(), 4u);
+		ASSERT(documents[0].positions == vector<int>({ 0, 1, 3, 4 }));
+		server.AddDocuments(documents);
+		ASSERT(server.GetWordFrequencies(1) == expected.GetWordFrequencies(1));
+		ASSERT(server.MatchDocument("funny curly rat"s, 1) == expected.MatchDocument("funny curly rat"s, 1));
+		try {
+			server.AddDocuments(documents);
+			ASSERT_HINT(false, "Tokenized documents with used ids must be rejected"s);
+		}
+		catch (const invalid_argument&) {
+		}
+	}
+
+	for (const string& malformed : { "1\tACTUAL\tcurly dog\n"s, "1\tGOOD\t\tcurly dog\n"s, "x\tACTUAL\t\tcurly dog\n"s,
+									 "4\tACTUAL\t\tcurly d\x01og\n"s }) {
+		SearchServer server(""sv);
+		try {
+			LoadCorpus(server, tsv_corpus.substr(0, tsv_corpus.find('\n') + 1) + malformed + tsv_corpus, { CorpusFormat::TSV, 1 });
+			ASSERT_HINT(false, "Malformed lines must be rejected"s);
+		}
+		catch (const invalid_argument&) {
+		}
+		ASSERT_EQUAL(server.GetDocumentCount(), 1);
+	}
+	try {
+		SearchServer server(""sv);
+		options.format = CorpusFormat::JSONL;
+		LoadCorpus(server, "{\"id\": 1, \"text\": \"a\"}\n{\"id\": 2, \"text\": \"unterminated}\n"s, options);
+		ASSERT_HINT(false, "Malformed lines must be rejected"s);
+	}
+	catch (const invalid_argument&) {
+	}
+}
+
+void TestDurableSearchServer() {
+	const auto directory = filesystem::temp_directory_path() / "search_server_wal_test";
+	filesystem::remove_all(directory);
+
+	const auto assert_same_documents = [](const SearchServer& server, const map<int, string>& documents) {
+		ASSERT_EQUAL(server.GetDocumentCount(), static_cast<int>(documents.size()));
+		for (const auto& [id, text] : documents) {
+			SearchServer expected(""sv);
+			expected.AddDocument(id, text, DocumentStatus::ACTUAL, {});
+			ASSERT(server.GetWordFrequencies(id) == expected.GetWordFrequencies(id));
+		}
+	};
+
+	map<int, string> documents = { { 1, "funny pet"s }, { 3, "curly dog"s }, { 4, "nasty rat"s } };
+	{
+		DurableSearchServer server(directory.string(), ""sv);
+		server.AddDocument(1, "funny pet"sv, DocumentStatus::ACTUAL, { 1, 2 });
+		server.AddDocument(2, "grey cat"sv, DocumentStatus::BANNED, {}, Durability::WRITTEN);
+		server.RemoveDocument(2);
+		server.ApplyBatch({ { WalRecordType::ADD_DOCUMENT, 3, DocumentStatus::ACTUAL, { -4 }, "curly dog"s },
+							{ WalRecordType::ADD_DOCUMENT, 4, DocumentStatus::ACTUAL, {}, "nasty rat"s } }, Durability::SYNCED);
+		// Rejected mutations are not logged
+		try {
+			server.AddDocument(1, "funny pet"sv, DocumentStatus::ACTUAL, {});
+			ASSERT_HINT(false, "Duplicate ids must be rejected"s);
+		}
+		catch (const invalid_argument&) {
+		}
+		server.Commit();
+	}
+	{
+		DurableSearchServer server(directory.string(), ""sv);
+		assert_same_documents(server.GetServer(), documents);
+		ASSERT_EQUAL(server.GetServer().FindTopDocuments("curly"s)[0].rating, -4);
+	}
+
+	// A torn record at the end of the log is dropped on recovery
+	ofstream(directory / "log.wal", ios::binary | ios::app) << "\x20\x00\x00\x00garbage"s;
+	{
+		DurableSearchServer server(directory.string(), ""sv);
+		assert_same_documents(server.GetServer(), documents);
+		server.RemoveDocument(4);
+		server.AddDocument(5, "white bird"sv, DocumentStatus::ACTUAL, {});
+		server.Checkpoint();
+		ASSERT_EQUAL(filesystem::file_size(directory / "log.wal"), 0u);
+		server.AddDocument(6, "black bird"sv, DocumentStatus::ACTUAL, {}, Durability::SYNCED);
+	}
+	documents.erase(4);
+	documents[5] = "white bird"s;
+	documents[6] = "black bird"s;
+	{
+		DurableSearchServer server(directory.string(), ""sv);
+		assert_same_documents(server.GetServer(), documents);
+	}
+
+	// A crash between writing the checkpoint and emptying the log replays the log again
+	filesystem::copy_file(directory / "log.wal", directory / "log.copy");
+	{
+		DurableSearchServer server(directory.string(), ""sv);
+		server.Checkpoint();
+	}
+	filesystem::rename(directory / "log.copy", directory / "log.wal");
+	{
+		DurableSearchServer server(directory.string(), ""sv);
+		assert_same_documents(server.GetServer(), documents);
+	}
+
+	// Syncs racing with checkpoints wait for the log their records went to
+	{
+		DurableSearchServer server(directory.string(), ""sv);
+		vector<thread> writers;
+		for (int writer = 0; writer < 4; ++writer) {
+			writers.emplace_back([&server, writer] {
+				for (int i = 0; i < 50; ++i) {
+					server.AddDocument(100 + writer * 50 + i, "grey cat"sv, DocumentStatus::ACTUAL, {},
+									   writer % 2 == 0 ? Durability::SYNCED : Durability::WRITTEN);
+					server.Commit();
+				}
+			});
+		}
+		for (int i = 0; i < 10; ++i) {
+			server.Checkpoint();
+		}
+		for (thread& writer : writers) {
+			writer.join();
+		}
+	}
+	{
+		DurableSearchServer server(directory.string(), ""sv);
+		ASSERT_EQUAL(server.GetServer().GetDocumentCount(), static_cast<int>(documents.size()) + 200);
+	}
+
+	// Sequence numbers past the end of a log do not wait for records that never come
+	{
+		WriteAheadLog log((directory / "other.wal").string());
+		const WalRecord record{ WalRecordType::REMOVE_DOCUMENT, 1, DocumentStatus::ACTUAL, {}, ""s };
+		ASSERT_EQUAL(log.Append(record), 1u);
+		log.Sync(100);
+	}
+	filesystem::remove_all(directory);
+}
+
+void TestSortByRelevanceInFoundResult() {
+	SearchServer server(""sv);
+	server.AddDocument(0, "white cat and a fashionable collar"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
+	server.AddDocument(1, "fluffy cat fluffy tail"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
+	server.AddDocument(2, "groomed dog expressive eyes"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
+
+	const auto found_docs = server.FindTopDocuments("fluffy groomed cat"sv);
+
+	for (size_t i = 0; i + 1 < found_docs.size(); ++i) {
+		ASSERT_HINT(found_docs[i].relevance > found_docs[i + 1].relevance,
+			"Found documents must be sorted by decrease"s);
+	}
+}
+
+void TestCalculateDocumentRating() {
+	SearchServer server(""sv);
+	server.AddDocument(0, "cat in the city"sv, DocumentStatus::ACTUAL, { 1, 3, 2 });
+	const auto documents = server.FindTopDocuments("cat"sv);
+	ASSERT_EQUAL(documents[0].rating, 2);
+}
+
+void TestFindTopDocumentsWithPredicate() {
+	SearchServer server(""sv);
+	server.AddDocument(0, "cat in the city"sv, DocumentStatus::ACTUAL, { 1, 3, 2 });
+	server.AddDocument(1, "cat in the city"sv, DocumentStatus::ACTUAL, { 1, 3, 2 });
+
+	const auto found_docs = server.FindTopDocuments("in"sv,
+		[](int document_id, DocumentStatus status, int rating) { return document_id == 1; });
+	ASSERT_EQUAL(found_docs.size(), 1);
+}
+
+void TestFindTopDocumentsWithStatus() {
+	SearchServer server(""sv);
+	server.AddDocument(0, "cat in the city"sv, DocumentStatus::ACTUAL, { 1, 3, 2 });
+	server.AddDocument(1, "cat in the city"sv, DocumentStatus::BANNED, { 1, 3, 2 });
+
+	const auto found_docs = server.FindTopDocuments("in"sv, DocumentStatus::BANNED);
+	ASSERT_EQUAL_HINT(found_docs.size(), 1, "Found documents must be certain status"s);
+}
+
+void TestFindTopDocumentsWithRatingRange() {
+	SearchServer server(""sv);
+	server.AddDocument(0, "cat in the city"sv, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(1, "cat in the city"sv, DocumentStatus::ACTUAL, { 5 });
+	server.AddDocument(2, "cat in the city"sv, DocumentStatus::BANNED, { 5 });
+
+	const auto found_docs = server.FindTopDocuments("cat"sv, RatingRange{ 2, 10 });
+	ASSERT_EQUAL(found_docs.size(), 2);
+
+	const auto actual_docs = server.FindTopDocuments(execution::par, "cat"sv, DocumentStatus::ACTUAL, RatingRange{ 2, 10 });
+	ASSERT_EQUAL(actual_docs.size(), 1);
+	ASSERT_EQUAL(actual_docs[0].id, 1);
+
+	server.RemoveDocument(2);
+	ASSERT_HINT(server.FindTopDocuments("cat"sv, DocumentStatus::BANNED).empty(), "Removed documents must not match status filter"s);
+}
+
+bool Equal(double a, double b) {
+	const double epsilon = 1e-6;
+
+	if (a >= 1) {
+		return abs(a - b) < epsilon;
+	}
+	else {
+		return abs(a - b) < epsilon * abs(a);
+	}
+}
+
+void TestCalculateDocumentRelevance() {
+	SearchServer server(""sv);
+	server.AddDocument(0, "white cat and a fashionable collar"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
+	server.AddDocument(1, "fluffy cat fluffy tail"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
+	server.AddDocument(2, "groomed dog expressive eyes"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
+
+	const auto found_docs = server.FindTopDocuments("fluffy groomed cat"sv);
+
+	ASSERT(Equal(found_docs[0].relevance, 0.65067242136109593));
+}
+
+void TestScoringKernelsAgree() {
+	const vector<string> words = { "cat"s, "dog"s, "tail"s, "eyes"s, "collar"s, "fluffy"s, "groomed"s };
+	const string query = "fluffy cat groomed -collar"s;
+
+	for (RankingModel ranking_model : { RankingModel::TF_IDF, RankingModel::BM25 }) {
+		SearchServerOptions options;
+		options.ranking_model = ranking_model;
+		SearchServer server(""sv, options);
+		for (int id = 0; id < 300; ++id) {
+			string text;
+			for (int i = 0; i < 1 + id % 5; ++i) {
+				text += words[(id * 7 + i * 3) % words.size()] + " "s;
+			}
+			server.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 10 });
+		}
+
+		SetScoringIsa(ScoringIsa::SCALAR);
+		const auto expected = server.FindTopDocuments(query);
+
+		for (ScoringIsa isa : { ScoringIsa::SCALAR, ScoringIsa::AVX2, ScoringIsa::AVX512 }) {
+			if (static_cast<int>(isa) > static_cast<int>(GetSupportedScoringIsa())) {
+				continue;
+			}
+			SetScoringIsa(isa);
+			for (bool prefetch : { false, true }) {
+				SetScoringPrefetch(prefetch);
+				for (const auto& found_docs : { server.FindTopDocuments(query), server.FindTopDocuments(execution::par, query) }) {
+					ASSERT_EQUAL_HINT(found_docs.size(), expected.size(), string(GetScoringIsaName(isa)));
+					for (size_t i = 0; i < found_docs.size(); ++i) {
+						ASSERT_EQUAL_HINT(found_docs[i].id, expected[i].id, string(GetScoringIsaName(isa)));
+						ASSERT_HINT(found_docs[i].relevance == expected[i].relevance, string(GetScoringIsaName(isa)));
+					}
+				}
+			}
+		}
+	}
+	SetScoringIsa(GetSupportedScoringIsa());
+	SetScoringPrefetch(true);
+}
+
+void TestBm25Ranking() {
+	SearchServerOptions options;
+	options.ranking_model = RankingModel::BM25;
+	SearchServer server(""sv, options);
+	server.AddDocument(0, "white cat and a fashionable collar"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
+	server.AddDocument(1, "fluffy cat fluffy tail"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
+	server.AddDocument(2, "groomed dog expressive eyes"sv, DocumentStatus::ACTUAL, { 1, 2, 3 });
+
+	const auto found_docs = server.FindTopDocuments("fluffy cat"sv);
+	ASSERT_EQUAL(found_docs.size(), 2);
+	ASSERT_EQUAL(found_docs[0].id, 1);
+
+	const double k1 = options.bm25_k1;
+	const double b = options.bm25_b;
+	const double average_length = 14.0 / 3;
+	const double fluffy_idf = log(1 + (3 - 1 + 0.5) / (1 + 0.5));
+	const double cat_idf = log(1 + (3 - 2 + 0.5) / (2 + 0.5));
+	const double norm = k1 * (1 - b + b * 4 / average_length);
+	const double expected = fluffy_idf * (k1 + 1) * 2 / (2 + norm) + cat_idf * (k1 + 1) * 1 / (1 + norm);
+	ASSERT(Equal(found_docs[0].relevance, expected));
+
+	const auto par_found_docs = server.FindTopDocuments(execution::par, "fluffy cat"sv);
+	ASSERT(Equal(par_found_docs[0].relevance, expected));
+}
+
+void TestPagination() {
+	SearchServer server(""sv);
+	for (int id = 0; id < 23; ++id) {
+		const string text = id % 3 == 0 ? "cat cat dog"s : id % 3 == 1 ? "cat dog dog"s : "cat bird"s;
+		server.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 4 });
+	}
+
+	QueryOptions all_options;
+	all_options.limit = 100;
+	const auto all_docs = server.FindTopDocuments("cat dog"s, all_options);
+	ASSERT_EQUAL(all_docs.size(), 23u);
+	ASSERT_EQUAL(server.FindTopDocuments("cat dog"s).size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+
+	const size_t page_size = 4;
+	vector<int> offset_ids;
+	vector<int> cursor_ids;
+	QueryOptions cursor_options;
+	cursor_options.limit = page_size;
+	for (size_t offset = 0; offset < all_docs.size(); offset += page_size) {
+		QueryOptions offset_options;
+		offset_options.offset = offset;
+		offset_options.limit = page_size;
+		for (const Document& document : server.FindTopDocuments(execution::par, "cat dog"s, offset_options)) {
+			offset_ids.push_back(document.id);
+		}
+
+		const auto page = server.FindTopDocuments("cat dog"s, cursor_options);
+		ASSERT(!page.empty());
+		for (const Document& document : page) {
+			cursor_ids.push_back(document.id);
+		}
+		cursor_options.search_after = DecodeSearchCursor(EncodeSearchCursor(MakeSearchCursor(page.back())));
+	}
+	ASSERT(server.FindTopDocuments("cat dog"s, cursor_options).empty());
+
+	vector<int> all_ids;
+	for (const Document& document : all_docs) {
+		all_ids.push_back(document.id);
+	}
+	ASSERT(offset_ids == all_ids);
+	ASSERT(cursor_ids == all_ids);
+
+	for (const string_view text : { ""sv, "1:2"sv, "1:2:x"sv, "1:2:3:"sv }) {
+		try {
+			DecodeSearchCursor(text);
+			ASSERT_HINT(false, "Malformed cursor must be rejected"s);
+		}
+		catch (const invalid_argument&) {
+		}
+	}
+}
+
+void TestPhraseAndProximityQueries() {
+	SearchServerOptions options;
+	options.store_word_positions = true;
+	SearchServer server("and with"s, options);
+	int id = 0;
+	for (const string& text : {
+			"funny pet and nasty rat"s,
+			"funny pet with curly hair"s,
+			"funny pet and not very nasty rat"s,
+			"pet with rat and rat and rat"s,
+			"nasty rat with curly hair"s,
+		}) {
+		server.AddDocument(++id, text, DocumentStatus::ACTUAL, { 1, 2 });
+	}
+
+	ASSERT(FoundIds(server.FindTopDocuments("\"curly hair\""s)) == vector<int>({ 2, 5 }));
+	ASSERT(server.FindTopDocuments("\"hair curly\""s).empty());
+	ASSERT_HINT(FoundIds(server.FindTopDocuments("\"pet with curly\""s)) == vector<int>({ 2 }), 
+		"Stop words keep their place in phrases"s);
+	ASSERT(FoundIds(server.FindTopDocuments("rat -\"nasty rat\""s)) == vector<int>({ 4 }));
+	ASSERT(FoundIds(server.FindTopDocuments(execution::par, "nasty NEAR/1 rat"s)) == vector<int>({ 1, 3, 5 }));
+	ASSERT(server.FindTopDocuments("pet NEAR/1 rat"s).empty());
+	ASSERT(FoundIds(server.FindTopDocuments("pet NEAR/2 rat"s)) == vector<int>({ 4 }));
+
+	const auto [matched_words, status] = server.MatchDocument("\"curly hair\""s, 1);
+	ASSERT(matched_words.empty());
+
+	server.RemoveDocument(2);
+	ASSERT(FoundIds(server.FindTopDocuments("\"curly hair\""s)) == vector<int>({ 5 }));
+
+	SearchServer plain_server("and with"s);
+	plain_server.AddDocument(1, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+	ASSERT_HINT(plain_server.FindTopDocuments("\"curly hair\""s).empty(), 
+		"Without positions quotes are part of the words"s);
+}
+
+void TestPrefixQueries() {
+	{
+		SearchServer server("and"s);
+		server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, { 1 });
+		server.AddDocument(2, "curious dog"s, DocumentStatus::ACTUAL, { 1 });
+		server.AddDocument(3, "cup of tea"s, DocumentStatus::ACTUAL, { 1 });
+		server.AddDocument(4, "car and cat"s, DocumentStatus::ACTUAL, { 1 });
+
+		ASSERT(FoundIds(server.FindTopDocuments("cu*"s)) == vector<int>({ 1, 2, 3 }));
+		ASSERT(FoundIds(server.FindTopDocuments(execution::par, "ca* -cur*"s)) == vector<int>({ 4 }));
+		ASSERT(server.FindTopDocuments("an*"s).empty());
+
+		const auto [matched_words, status] = server.MatchDocument("cu* dog"s, 2);
+		ASSERT(matched_words == vector<string_view>({ "curious"sv, "dog"sv }));
+	}
+
+	{
+		SearchServerOptions options;
+		options.max_prefix_expansions = 1;
+		SearchServer server(""s, options);
+		server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, { 1 });
+		server.AddDocument(2, "curious cat"s, DocumentStatus::ACTUAL, { 1 });
+		server.AddDocument(3, "curious dog"s, DocumentStatus::ACTUAL, { 1 });
+		ASSERT_HINT(FoundIds(server.FindTopDocuments("cur*"s)) == vector<int>({ 2, 3 }), 
+			"Expansions found in most documents go first"s);
+	}
+}
+
+void TestMinimumShouldMatch() {
+	{
+		const vector<string> words = { "cat"s, "dog"s, "bird"s, "fish"s, "mouse"s };
+		SearchServer server("and"s);
+		for (int id = 0; id < 300; ++id) {
+			string text = "pet"s;
+			for (size_t i = 0; i < words.size(); ++i) {
+				if ((id * 7 + id / 32) >> i & 1) {
+					text += " "s + words[i];
+				}
+			}
+			server.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 10 });
+		}
+
+		const string query = "cat dog bird and -mouse"s;
+		QueryOptions any_options;
+		any_options.limit = 1000;
+		const auto any_found_docs = server.FindTopDocuments(query, any_options);
+		for (size_t minimum_should_match : { size_t{ 2 }, size_t{ 3 }, ALL_QUERY_WORDS }) {
+			map<int, double> expected;
+			for (const Document& document : any_found_docs) {
+				if (get<0>(server.MatchDocument(query, document.id)).size() >= min<size_t>(minimum_should_match, 3)) {
+					expected[document.id] = document.relevance;
+				}
+			}
+			ASSERT(!expected.empty());
+
+			QueryOptions options = any_options;
+			options.minimum_should_match = minimum_should_match;
+			for (const auto& found_docs : { server.FindTopDocuments(query, options), server.FindTopDocuments(execution::par, query, options) }) {
+				ASSERT_EQUAL(found_docs.size(), expected.size());
+				for (const Document& document : found_docs) {
+					ASSERT_EQUAL(expected.count(document.id), 1u);
+					ASSERT(abs(document.relevance - expected.at(document.id)) < 1e-9);
+				}
+			}
+		}
+	}
+
+	{
+		SearchServer server(""s);
+		server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, { 1 });
+		server.AddDocument(2, "cat and cats"s, DocumentStatus::ACTUAL, { 1 });
+		server.AddDocument(3, "cats and dog"s, DocumentStatus::ACTUAL, { 1 });
+		QueryOptions options;
+		options.minimum_should_match = ALL_QUERY_WORDS;
+		ASSERT_HINT(FoundIds(server.FindTopDocuments("ca* and"s, options)) == vector<int>({ 2, 3 }), 
+			"Expansions of a prefix satisfy the same word"s);
+		ASSERT(server.FindTopDocuments("cat unknown"s, options).empty());
+
+		options.max_edit_distance = 1;
+		ASSERT(FoundIds(server.FindTopDocuments("cat dig"s, options)) == vector<int>({ 3 }));
+
+		string long_query;
+		for (int i = 0; i < 65; ++i) {
+			long_query += "w"s + to_string(i) + " "s;
+		}
+		ASSERT(server.FindTopDocuments(long_query).empty());
+		try {
+			server.FindTopDocuments(long_query, options);
+			ASSERT_HINT(false, "More words than clause bits"s);
+		}
+		catch (const invalid_argument&) {
+		}
+	}
+}
+
+void TestFuzzyQueries() {
+	SearchServer server("and"s);
+	server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(2, "nasty dog"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(3, "funny rat"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(4, "curly hair"s, DocumentStatus::ACTUAL, { 1 });
+
+	ASSERT(server.FindTopDocuments("curlu"s).empty());
+
+	QueryOptions options;
+	options.max_edit_distance = 2;
+	ASSERT(FoundIds(server.FindTopDocuments("curlu"s, options)) == vector<int>({ 1, 4 }));
+	ASSERT(FoundIds(server.FindTopDocuments(execution::par, "nsaty"s, options)) == vector<int>({ 2 }));
+
+	const auto found_docs = server.FindTopDocuments("cat"s, options);
+	ASSERT_EQUAL(found_docs.size(), 2);
+	ASSERT_EQUAL(found_docs[0].id, 1);
+	ASSERT_EQUAL_HINT(found_docs[1].id, 3, "rat is one edit away from cat"s);
+	ASSERT_HINT(found_docs[1].relevance < found_docs[0].relevance, "Fuzzy matches must weigh less"s);
+
+	ASSERT_HINT(server.FindTopDocuments("ca"s, options).empty(), "Short words are matched exactly"s);
+}
+
+void SplitIntoWordsTest() {
+	
+
+	vector<string_view> str1 = SplitIntoWords("");
+	vector<string_view> str2 = SplitIntoWords(" ");
+	vector<string_view> str3 = SplitIntoWords("  ");
+	vector<string_view> str4 = SplitIntoWords(" a  ");
+	vector<string_view> str5 = SplitIntoWords("asd asd");
+	vector<string_view> str6 = SplitIntoWords(" asd   asd");
+	vector<string_view> str7 = SplitIntoWords(" asd   asd   ");
+	vector<string_view> str8 = SplitIntoWords("a");
+
+	vector<string_view> str9 = { "asd"sv, "asd"sv };
+	vector<string_view> str10 = { "a"sv };
+
+	ASSERT_HINT(str1.empty(), "");
+	ASSERT_HINT(str2.empty(), "");
+	ASSERT_HINT(str3.empty(), "");
+	ASSERT_HINT(str4 == str8, "");
+	ASSERT_HINT(str4 == str10, "");
+	ASSERT_HINT(str5 == str9, "");
+	ASSERT_HINT(str5 == str6, "");
+	ASSERT_HINT(str5 == str7, "");
+}
+
+void TestSearchServer() {
+	RUN_TEST(SplitIntoWordsTest);
+	RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
+	RUN_TEST(TestExcludeMinusWordsFromFoundResult);
+	RUN_TEST(TestMatchDocument);
+	RUN_TEST(TestMatchDocumentPolicies);
+	RUN_TEST(TestMatchDocuments);
+	RUN_TEST(TestPreparedQueries);
+	RUN_TEST(TestRemoveDocuments);
+	RUN_TEST(TestRemoveDuplicates);
+	RUN_TEST(TestFindNearDuplicates);
+	RUN_TEST(TestConcurrentMap);
+	RUN_TEST(TestIndexAllocator);
+	RUN_TEST(TestNumaPlacement);
+	RUN_TEST(TestIndexStatistics);
+	RUN_TEST(TestSparseDocumentIds);
+	RUN_TEST(TestRequestQueue);
+	RUN_TEST(TestProcessQueriesJoined);
+	RUN_TEST(TestQueryStats);
+	RUN_TEST(TestHdrHistogram);
+	RUN_TEST(TestLoadCorpus);
+	RUN_TEST(TestDurableSearchServer);
+	RUN_TEST(TestSortByRelevanceInFoundResult);
+	RUN_TEST(TestCalculateDocumentRating);
+	RUN_TEST(TestFindTopDocumentsWithPredicate);
+	RUN_TEST(TestFindTopDocumentsWithStatus);
+	RUN_TEST(TestFindTopDocumentsWithRatingRange);
+	RUN_TEST(TestCalculateDocumentRelevance);
+	RUN_TEST(TestScoringKernelsAgree);
+	RUN_TEST(TestBm25Ranking);
+	RUN_TEST(TestPagination);
+	RUN_TEST(TestPhraseAndProximityQueries);
+	RUN_TEST(TestPrefixQueries);
+	RUN_TEST(TestMinimumShouldMatch);
+	RUN_TEST(TestFuzzyQueries);
+
+}
+
+void SomeTest() {
+	cout << "Search server testing finished"s << endl;
+
+	SearchServer search_server("and with"s);
+
+	int id = 0;
+	for (
+		const string& text : {
+			"funny pet and nasty rat"s,
+			"funny pet with curly hair"s,
+			"funny pet and not very nasty rat"s,
+			"pet with rat and rat and rat"s,
+			"nasty rat with curly hair"s,
+		}
+		) {
+		search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, { 1, 2 });
+	}
+
+	const vector<string> queries = {
+		"nasty rat -not"s,
+		"not very funny nasty pet"s,
+		"curly hair"s
+	};
+	for (const Document& document : ProcessQueriesJoined(search_server, queries)) {
+		cout << "Document "s << document.id << " matched with relevance "s << document.relevance << endl;
+	}
+}
+
+void TaskTest() {
+	SearchServer search_server("and with"s);
+
+	int id = 0;
+	for (
+		const string& text : {
+			"white cat and yellow hat"s,
+			"curly cat curly tail"s,
+			"nasty dog with big eyes"s,
+			"nasty pigeon john"s,
+		}
+		) {
+		search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, { 1, 2 });
+	}
+
+
+	cout << "ACTUAL by default:"s << endl;
+
+	for (const Document& document : search_server.FindTopDocuments("curly nasty cat"s)) {
+		PrintDocument(document);
+	}
+	cout << "BANNED:"s << endl;
+
+	for (const Document& document : search_server.FindTopDocuments(execution::par, "curly nasty cat"s, DocumentStatus::BANNED)) {
+		PrintDocument(document);
+	}
+
+	cout << "Even ids:"s << endl;
+
+	for (const Document& document : search_server.FindTopDocuments(execution::par, "curly nasty cat"s, [](int document_id, DocumentStatus status, int rating) { return document_id % 2 == 0; })) {
+		PrintDocument(document);
+	}
+}
+
+
+
+string GenerateWord(mt19937& generator, int max_length) {
+	const int length = uniform_int_distribution(1, max_length)(generator);
+	string word;
+	word.reserve(length);
+	for (int i = 0; i < length; ++i) {
+		word.push_back(uniform_int_distribution(int('a'), int('z'))(generator));
+	}
+	return word;
+}
+
+vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+	vector<string> words;
+	words.reserve(word_count);
+	for (int i = 0; i < word_count; ++i) {
+		words.push_back(GenerateWord(generator, max_length));
+	}
+	words.erase(unique(words.begin(), words.end()), words.end());
+	return words;
+}
+
+string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
+	string query;
+	for (int i = 0; i < word_count; ++i) {
+		if (!query.empty()) {
+			query.push_back(' ');
+		}
+		if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+			query.push_back('-');
+		}
+		query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+	}
+	return query;
+}
+
+vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
+	vector<string> queries;
+	queries.reserve(query_count);
+	for (int i = 0; i < query_count; ++i) {
+		queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+	}
+	return queries;
+}
+
+template <typename ExecutionPolicy>
+void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
+	LogDuration a(string(mark), cout);
+	double total_relevance = 0;
+	for (const string_view query : queries) {
+		for (const auto& document : search_server.FindTopDocuments(policy, query)) {
+			total_relevance += document.relevance;
+		}
+	}
+	cout << total_relevance << endl;
+}
+
+#define TEST(policy) Test(#policy, search_server, queries, execution::policy)
+
+
+int main() {
+	TestSearchServer();
+	SomeTest();
+	TaskTest();
+
+	mt19937 generator;
+
+	const auto dictionary = GenerateDictionary(generator, 1000, 10);
+	const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
+
+	SearchServer search_server(dictionary[0]);
+	for (size_t i = 0; i < documents.size(); ++i) {
+		search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+	}
+
+	const auto queries = GenerateQueries(generator, dictionary, 100, 70);
+
+	TEST(seq);
+	TEST(par);
 }
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "minhash.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+vector<uint32_t> ComputeMinHashSignature(TermIds term_ids, size_t signature_size) {
+	vector<uint64_t> seeds(signature_size);
+	for (size_t i = 0; i < signature_size; ++i) {
+		seeds[i] = MixBits(i + 1);
+	}
+
+	vector<uint32_t> signature(signature_size, numeric_limits<uint32_t>::max());
+	// Every term is mixed once, the hash functions then differ by a seed and an odd multiplier
+	for (const int term_id : term_ids) {
+		const uint64_t term_hash = MixBits(static_cast<uint32_t>(term_id));
+		for (size_t i = 0; i < signature_size; ++i) {
+			const uint32_t hash = static_cast<uint32_t>(((term_hash ^ seeds[i]) * (seeds[i] | 1)) >> 32);
+			signature[i] = min(signature[i], hash);
+		}
+	}
+	return signature;
+}
+
+double EstimateJaccardSimilarity(const vector<uint32_t>& lhs, const vector<uint32_t>& rhs) {
+	if (lhs.empty()) {
+		return 0.0;
+	}
+	size_t equal_rows = 0;
+	for (size_t i = 0; i < lhs.size(); ++i) {
+		equal_rows += lhs[i] == rhs[i];
+	}
+	return static_cast<double>(equal_rows) / lhs.size();
+}
+
+double ComputeJaccardSimilarity(TermIds lhs, TermIds rhs) {
+	if (lhs.empty() && rhs.empty()) {
+		return 1.0;
+	}
+	size_t common = 0;
+	for (size_t i = 0, j = 0; i < lhs.size() && j < rhs.size();) {
+		if (lhs[i] < rhs[j]) {
+			++i;
+		}
+		else if (rhs[j] < lhs[i]) {
+			++j;
+		}
+		else {
+			++common;
+			++i;
+			++j;
+		}
+	}
+	return static_cast<double>(common) / (lhs.size() + rhs.size() - common);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "forward_index.h"
+
+// SplitMix64 finalizer, spreads the bits of term ids and seeds over the whole word
+inline uint64_t MixBits(uint64_t value) {
+	value ^= value >> 30;
+	value *= 0xBF58476D1CE4E5B9ull;
+	value ^= value >> 27;
+	value *= 0x94D049BB133111EBull;
+	return value ^ (value >> 31);
+}
+
+// Row i of a MinHash signature is the minimum of the i-th hash function over the
+// term ids of a document. Two documents agree on a row with probability equal to
+// the Jaccard similarity of their word sets.
+std::vector<uint32_t> ComputeMinHashSignature(TermIds term_ids, size_t signature_size);
+
+// Fraction of rows two signatures of the same size agree on
+double EstimateJaccardSimilarity(const std::vector<uint32_t>& lhs, const std::vector<uint32_t>& rhs);
+
+// Exact Jaccard similarity of two sorted id sets, 1 for two empty sets
+double ComputeJaccardSimilarity(TermIds lhs, TermIds rhs);
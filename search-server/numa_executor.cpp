@@ -0,0 +1,197 @@
+#include "numa_executor.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Tasks a worker may have queued before Run blocks
+const size_t WORKER_QUEUE_CAPACITY = 64;
+
+#ifdef __linux__
+// Parses the kernel's CPU list format, such as "0-3,8-11"
+vector<int> ParseCpuList(const string& text) {
+	vector<int> cpus;
+	istringstream input(text);
+	string range;
+	while (getline(input, range, ',')) {
+		int first = 0;
+		int last = 0;
+		const size_t dash = range.find('-');
+		try {
+			first = stoi(range.substr(0, dash));
+			last = dash == string::npos ? first : stoi(range.substr(dash + 1));
+		}
+		catch (const exception&) {
+			continue;
+		}
+		for (int cpu = first; cpu <= last; ++cpu) {
+			cpus.push_back(cpu);
+		}
+	}
+	return cpus;
+}
+#endif
+
+void PinCurrentThread(const vector<int>& cpus) {
+#ifdef _WIN32
+	// Windows numbers CPUs within processor groups of 64
+	GROUP_AFFINITY affinity = {};
+	affinity.Group = static_cast<WORD>(cpus.front() / 64);
+	for (const int cpu : cpus) {
+		if (cpu / 64 == affinity.Group) {
+			affinity.Mask |= KAFFINITY(1) << (cpu % 64);
+		}
+	}
+	SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr);
+#elif defined(__linux__)
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	for (const int cpu : cpus) {
+		if (cpu < CPU_SETSIZE) {
+			CPU_SET(cpu, &cpu_set);
+		}
+	}
+	// A failure only costs locality, the thread keeps running where it is
+	pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#else
+	static_cast<void>(cpus);
+#endif
+}
+
+}  // namespace
+
+NumaTopology DetectNumaTopology() {
+	NumaTopology topology;
+#ifdef _WIN32
+	ULONG highest_node = 0;
+	if (GetNumaHighestNodeNumber(&highest_node)) {
+		for (USHORT node = 0; node <= highest_node; ++node) {
+			GROUP_AFFINITY affinity = {};
+			if (!GetNumaNodeProcessorMaskEx(node, &affinity) || affinity.Mask == 0) {
+				continue;
+			}
+			vector<int> cpus;
+			for (int bit = 0; bit < 64; ++bit) {
+				if (affinity.Mask & (KAFFINITY(1) << bit)) {
+					cpus.push_back(affinity.Group * 64 + bit);
+				}
+			}
+			topology.node_cpus.push_back(move(cpus));
+		}
+	}
+#elif defined(__linux__)
+	for (int node = 0;; ++node) {
+		ifstream cpu_list("/sys/devices/system/node/node"s + to_string(node) + "/cpulist"s);
+		if (!cpu_list) {
+			break;
+		}
+		string text;
+		getline(cpu_list, text);
+		vector<int> cpus = ParseCpuList(text);
+		// Memory-only nodes have no CPUs to run workers on
+		if (!cpus.empty()) {
+			topology.node_cpus.push_back(move(cpus));
+		}
+	}
+#endif
+	if (topology.node_cpus.empty()) {
+		vector<int> cpus(max(thread::hardware_concurrency(), 1u));
+		for (size_t cpu = 0; cpu < cpus.size(); ++cpu) {
+			cpus[cpu] = static_cast<int>(cpu);
+		}
+		topology.node_cpus.push_back(move(cpus));
+	}
+	return topology;
+}
+
+NumaTopology SimulateNumaTopology(size_t node_count, size_t cpus_per_node) {
+	NumaTopology topology;
+	topology.is_simulated = true;
+	for (size_t node = 0; node < node_count; ++node) {
+		vector<int> cpus(cpus_per_node);
+		for (size_t i = 0; i < cpus_per_node; ++i) {
+			cpus[i] = static_cast<int>(node * cpus_per_node + i);
+		}
+		topology.node_cpus.push_back(move(cpus));
+	}
+	return topology;
+}
+
+NumaExecutor::NumaExecutor(NumaTopology topology, size_t threads_per_node)
+	: topology_(move(topology))
+	, workers_(topology_.node_cpus.size()) {
+	for (size_t node = 0; node < workers_.size(); ++node) {
+		const vector<int>& cpus = topology_.node_cpus[node];
+		const size_t worker_count = threads_per_node > 0 ? threads_per_node : max<size_t>(cpus.size(), 1);
+		for (size_t i = 0; i < worker_count; ++i) {
+			auto worker = make_unique<Worker>(WORKER_QUEUE_CAPACITY);
+			worker->thread = thread([this, &cpus, tasks = &worker->tasks] {
+				if (!topology_.is_simulated && !cpus.empty()) {
+					PinCurrentThread(cpus);
+				}
+				packaged_task<void()> task;
+				while (tasks->Pop(task)) {
+					task();
+				}
+				});
+			workers_[node].push_back(move(worker));
+		}
+	}
+}
+
+NumaExecutor::~NumaExecutor() {
+	for (auto& node_workers : workers_) {
+		for (auto& worker : node_workers) {
+			worker->tasks.Close();
+		}
+	}
+	for (auto& node_workers : workers_) {
+		for (auto& worker : node_workers) {
+			worker->thread.join();
+		}
+	}
+}
+
+const NumaTopology& NumaExecutor::GetTopology() const {
+	return topology_;
+}
+
+size_t NumaExecutor::GetNodeCount() const {
+	return workers_.size();
+}
+
+size_t NumaExecutor::GetWorkerCount(size_t node) const {
+	return workers_[node].size();
+}
+
+void NumaExecutor::Run(const function<void(size_t node, size_t worker)>& task) const {
+	vector<future<void>> results;
+	for (size_t node = 0; node < workers_.size(); ++node) {
+		for (size_t worker = 0; worker < workers_[node].size(); ++worker) {
+			packaged_task<void()> worker_task([&task, node, worker] {
+				task(node, worker);
+				});
+			results.push_back(worker_task.get_future());
+			workers_[node][worker]->tasks.Push(move(worker_task));
+		}
+	}
+	// Every task is waited for before the first exception is rethrown, as they all use task
+	for (auto& result : results) {
+		result.wait();
+	}
+	for (auto& result : results) {
+		result.get();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "bounded_queue.h"
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+struct NumaTopology {
+	// CPUs of every node
+	std::vector<std::vector<int>> node_cpus;
+	// Simulated nodes have made up CPUs, threads are not pinned to them
+	bool is_simulated = false;
+};
+
+// Nodes of this machine, a single node with every CPU where NUMA is unknown
+NumaTopology DetectNumaTopology();
+
+// node_count nodes of cpus_per_node CPUs each, for tests on single-node machines
+NumaTopology SimulateNumaTopology(size_t node_count, size_t cpus_per_node);
+
+// Worker threads pinned to the CPUs of their node. Memory a worker writes first
+// is allocated on its node, and the work it is given reads that memory locally.
+class NumaExecutor {
+public:
+	// threads_per_node 0 starts one worker per CPU of the node
+	explicit NumaExecutor(NumaTopology topology, size_t threads_per_node = 0);
+	~NumaExecutor();
+
+	NumaExecutor(const NumaExecutor&) = delete;
+	NumaExecutor& operator=(const NumaExecutor&) = delete;
+
+	const NumaTopology& GetTopology() const;
+	size_t GetNodeCount() const;
+	size_t GetWorkerCount(size_t node) const;
+
+	// Calls task(node, worker) once on every worker and waits for all of them.
+	// The first exception thrown by a task is rethrown. Tasks must not call Run.
+	void Run(const std::function<void(size_t node, size_t worker)>& task) const;
+
+private:
+	struct Worker {
+		explicit Worker(size_t queue_capacity)
+			: tasks(queue_capacity) {
+		}
+
+		BoundedQueue<std::packaged_task<void()>> tasks;
+		std::thread thread;
+	};
+
+	const NumaTopology topology_;
+	// Workers of every node, node by node
+	std::vector<std::vector<std::unique_ptr<Worker>>> workers_;
+};
+
+// Execution policy for SearchServer queries: the documents of every node's id range
+// are scored by the workers of that node. See SearchServer::PlaceOnNumaNodes.
+struct NumaPolicy {
+	const NumaExecutor* executor;
+};
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "posting_list.h"
+#include "intersection.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+void EncodePositions(const vector<int>& word_positions, vector<uint8_t>& encoded) {
+	int previous = 0;
+	for (const int position : word_positions) {
+		uint32_t gap = static_cast<uint32_t>(position - previous);
+		while (gap >= 0x80) {
+			encoded.push_back(static_cast<uint8_t>(gap | 0x80));
+			gap >>= 7;
+		}
+		encoded.push_back(static_cast<uint8_t>(gap));
+		previous = position;
+	}
+}
+
+}  // namespace
+
+void PostingList::Add(int slot, double term_freq) {
+	// New documents take the highest slot, so appending is the common case
+	if (slots.empty() || slots.back() < slot) {
+		slots.push_back(slot);
+		term_freqs.push_back(term_freq);
+		return;
+	}
+	const auto it = lower_bound(slots.begin(), slots.end(), slot);
+	const auto index = it - slots.begin();
+	if (it != slots.end() && *it == slot) {
+		term_freqs[index] += term_freq;
+		return;
+	}
+	slots.insert(it, slot);
+	term_freqs.insert(term_freqs.begin() + index, term_freq);
+}
+
+void PostingList::Add(int slot, double term_freq, const vector<int>& word_positions) {
+	vector<uint8_t> encoded;
+	EncodePositions(word_positions, encoded);
+
+	const size_t index = lower_bound(slots.begin(), slots.end(), slot) - slots.begin();
+	Add(slot, term_freq);
+
+	if (position_offsets.empty()) {
+		position_offsets.push_back(0);
+	}
+	const uint32_t offset = position_offsets[index];
+	positions.insert(positions.begin() + offset, encoded.begin(), encoded.end());
+	position_offsets.insert(position_offsets.begin() + index, offset);
+	for (size_t i = index + 1; i < position_offsets.size(); ++i) {
+		position_offsets[i] += static_cast<uint32_t>(encoded.size());
+	}
+}
+
+void PostingList::Remove(int slot) {
+	const size_t index = Find(slot);
+	if (index == size()) {
+		return;
+	}
+	term_freqs.erase(term_freqs.begin() + index);
+	slots.erase(slots.begin() + index);
+
+	if (!position_offsets.empty()) {
+		const uint32_t first = position_offsets[index];
+		const uint32_t removed = position_offsets[index + 1] - first;
+		positions.erase(positions.begin() + first, positions.begin() + first + removed);
+		position_offsets.erase(position_offsets.begin() + index);
+		for (size_t i = index; i < position_offsets.size(); ++i) {
+			position_offsets[i] -= removed;
+		}
+	}
+}
+
+void PostingList::Remove(const int* first_removed, const int* last_removed) {
+	const bool has_positions = !position_offsets.empty();
+	const int* removed_it = first_removed;
+	size_t kept = 0;
+	uint32_t kept_position_bytes = 0;
+	for (size_t i = 0; i < size(); ++i) {
+		removed_it = GallopLowerBound(removed_it, last_removed, slots[i]);
+		if (removed_it != last_removed && *removed_it == slots[i]) {
+			continue;
+		}
+		if (has_positions) {
+			// Kept postings only move towards the front, so compacting in place is safe
+			const uint32_t first = position_offsets[i];
+			const uint32_t last = position_offsets[i + 1];
+			if (kept_position_bytes != first) {
+				copy(positions.begin() + first, positions.begin() + last, positions.begin() + kept_position_bytes);
+			}
+			position_offsets[kept] = kept_position_bytes;
+			kept_position_bytes += last - first;
+		}
+		slots[kept] = slots[i];
+		term_freqs[kept] = term_freqs[i];
+		++kept;
+	}
+	slots.resize(kept);
+	term_freqs.resize(kept);
+	if (has_positions) {
+		position_offsets[kept] = kept_position_bytes;
+		position_offsets.resize(kept + 1);
+		positions.resize(kept_position_bytes);
+	}
+}
+
+void PostingList::RemapSlots(const vector<int>& new_slots) {
+	for (int& slot : slots) {
+		slot = new_slots[slot];
+	}
+}
+
+size_t PostingList::GetMemoryUsage() const {
+	return slots.capacity() * sizeof(int) + term_freqs.capacity() * sizeof(double) 
+		+ positions.capacity() * sizeof(uint8_t) + position_offsets.capacity() * sizeof(uint32_t);
+}
+
+size_t PostingList::Find(int slot) const {
+	const auto it = lower_bound(slots.begin(), slots.end(), slot);
+	return it != slots.end() && *it == slot ? it - slots.begin() : size();
+}
+
+pair<size_t, size_t> PostingList::FindRange(int first_slot, int last_slot) const {
+	const auto first = lower_bound(slots.begin(), slots.end(), first_slot);
+	const auto last = lower_bound(first, slots.end(), last_slot);
+	return { static_cast<size_t>(first - slots.begin()), static_cast<size_t>(last - slots.begin()) };
+}
+
+vector<int> PostingList::GetPositions(size_t index) const {
+	vector<int> word_positions;
+	if (position_offsets.empty()) {
+		return word_positions;
+	}
+	int position = 0;
+	uint32_t gap = 0;
+	int shift = 0;
+	for (uint32_t i = position_offsets[index]; i < position_offsets[index + 1]; ++i) {
+		gap |= static_cast<uint32_t>(positions[i] & 0x7F) << shift;
+		if (positions[i] & 0x80) {
+			shift += 7;
+			continue;
+		}
+		position += static_cast<int>(gap);
+		word_positions.push_back(position);
+		gap = 0;
+		shift = 0;
+	}
+	return word_positions;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "index_allocator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Postings of a single word: document slots in ascending order and their term
+// frequencies in a parallel array, so that scoring runs over flat blocks
+struct PostingList {
+	IndexVector<int> slots;
+	IndexVector<double> term_freqs;
+
+	// Filled only by servers that store word positions. The positions of the word
+	// in slot slots[i] are varint-encoded gaps starting at positions[position_offsets[i]].
+	std::vector<uint8_t> positions;
+	std::vector<uint32_t> position_offsets;
+
+	size_t size() const {
+		return slots.size();
+	}
+
+	bool empty() const {
+		return slots.empty();
+	}
+
+	// Bytes held by the arrays, by capacity
+	size_t GetMemoryUsage() const;
+
+	void Add(int slot, double term_freq);
+	void Add(int slot, double term_freq, const std::vector<int>& word_positions);
+	void Remove(int slot);
+	// Removes the postings of all the ascending ids in [first_removed, last_removed) in one pass
+	void Remove(const int* first_removed, const int* last_removed);
+	// Renumbers the slots as ForwardIndex::RemapSlots does, none of them may be removed
+	void RemapSlots(const std::vector<int>& new_slots);
+
+	// Index of the posting of the document in slot, or size() if there is none
+	size_t Find(int slot) const;
+
+	// Positions of the postings with slots in [first_slot, last_slot)
+	std::pair<size_t, size_t> FindRange(int first_slot, int last_slot) const;
+
+	// Ascending word positions of the posting at index
+	std::vector<int> GetPositions(size_t index) const;
+};
@@ -1,28 +1,71 @@
-#include "search_server.h"
-#include "process_queries.h"
-
-#include <vector>
-#include <string>
-#include <list>
-#include <execution>
-#include <functional>
-
-using namespace std;
-
-Docs ProcessQueriesJoined(const SearchServer& search_server,
-						  const std::vector<std::string>& queries) {
-	return Docs(ProcessQueries(search_server, queries));
-}
-
-std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server,
-	const std::vector<std::string>& queries) {
-	vector<vector<Document>> responses(queries.size());
-
-	transform(execution::par, queries.begin(), queries.end(), responses.begin(),
-		[&search_server](const string& query) {
-			return search_server.FindTopDocuments(query);
-		}
-	);
-
-	return responses;
+#include "search_server.h"
+#include "process_queries.h"
+
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <execution>
+#include <functional>
+#include <numeric>
+
+using namespace std;
+
+Docs ProcessQueriesJoined(const SearchServer& search_server,
+						  const std::vector<std::string>& queries) {
+	// No query returns more than MAX_RESULT_DOCUMENT_COUNT documents, so each one
+	// writes into a fixed slot of the shared buffer, and the slots are packed afterwards
+	vector<Document> documents(queries.size() * MAX_RESULT_DOCUMENT_COUNT);
+	vector<size_t> offsets(queries.size() + 1);
+	vector<size_t> query_indexes(queries.size());
+	iota(query_indexes.begin(), query_indexes.end(), 0);
+
+	for_each(execution::par, query_indexes.begin(), query_indexes.end(),
+		[&search_server, &queries, &documents, &offsets](size_t query_index) {
+			// found is the buffer the server scored the candidates in, cut down to the top
+			// documents in place. Scoring needs it anyway, so it is the only allocation here.
+			vector<Document> found = search_server.FindTopDocuments(queries[query_index]);
+			move(found.begin(), found.end(), documents.begin() + query_index * MAX_RESULT_DOCUMENT_COUNT);
+			offsets[query_index + 1] = found.size();
+		}
+	);
+
+	// Documents only move towards the front. Slots already in place are skipped,
+	// std::move does not allow its destination to start inside the source range.
+	for (size_t query_index = 0; query_index < queries.size(); ++query_index) {
+		const size_t slot_offset = query_index * MAX_RESULT_DOCUMENT_COUNT;
+		if (offsets[query_index] != slot_offset) {
+			const auto slot = documents.begin() + slot_offset;
+			move(slot, slot + offsets[query_index + 1], documents.begin() + offsets[query_index]);
+		}
+		offsets[query_index + 1] += offsets[query_index];
+	}
+	documents.resize(offsets.back());
+
+	return Docs(move(documents), move(offsets));
+}
+
+std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server,
+	const std::vector<std::string>& queries) {
+	vector<vector<Document>> responses(queries.size());
+
+	transform(execution::par, queries.begin(), queries.end(), responses.begin(),
+		[&search_server](const string& query) {
+			return search_server.FindTopDocuments(query);
+		}
+	);
+
+	return responses;
+}
+
+std::vector<std::vector<Document>> ProcessQueries(RequestQueue& request_queue,
+	const std::vector<std::string>& queries) {
+	vector<vector<Document>> responses(queries.size());
+
+	transform(execution::par, queries.begin(), queries.end(), responses.begin(),
+		[&request_queue](const string& query) {
+			return request_queue.AddFindRequest(query);
+		}
+	);
+
+	return responses;
 }
\ No newline at end of file
@@ -1,45 +1,52 @@
-#pragma once
-
-#include "search_server.h"
-#include "basic_iterator.h"
-
-#include <vector>
-#include <string>
-#include <list>
-
-class  Docs {
-
-	using BasicIterator = BasicIterator<Document, std::vector<Document>::iterator, std::vector<std::vector<Document>>::iterator>;
-
-public:
-
-	Docs(const Docs& rhs) : docs_(rhs.docs_) {
-	}
-
-	Docs(Docs&& rhs) noexcept : docs_(move(rhs.docs_)) {
-	}
-
-	Docs(const std::vector<std::vector<Document>>& docs) : docs_(docs) {
-	}
-
-	Docs(std::vector<std::vector<Document>>&& docs) : docs_(move(docs)) {
-	}
-
-	BasicIterator begin() {
-		return BasicIterator(docs_.begin(), docs_.end());
-	}
-
-	BasicIterator end() {
-		return BasicIterator(docs_.end(), docs_.end());
-	}
-
-private:
-	std::vector<std::vector<Document>> docs_;
-};
-
-Docs ProcessQueriesJoined(
-	const SearchServer& search_server,
-	const std::vector<std::string>& queries);
-
-std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server,
+#pragma once
+
+#include "search_server.h"
+#include "request_queue.h"
+#include "paginator.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Results of many queries in one buffer: the documents of query i are
+// [offsets[i], offsets[i + 1]), so iterating all of them is a flat scan
+class Docs {
+public:
+	using Iterator = std::vector<Document>::const_iterator;
+
+	Docs(std::vector<Document> documents, std::vector<size_t> offsets)
+		: documents_(std::move(documents))
+		, offsets_(std::move(offsets)) {
+	}
+
+	Iterator begin() const {
+		return documents_.begin();
+	}
+
+	Iterator end() const {
+		return documents_.end();
+	}
+
+	size_t GetQueryCount() const {
+		return offsets_.size() - 1;
+	}
+
+	IteratorRange<Iterator> GetQueryResults(size_t query_index) const {
+		return { documents_.begin() + offsets_[query_index], documents_.begin() + offsets_[query_index + 1] };
+	}
+
+private:
+	std::vector<Document> documents_;
+	std::vector<size_t> offsets_;
+};
+
+Docs ProcessQueriesJoined(
+	const SearchServer& search_server,
+	const std::vector<std::string>& queries);
+
+std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server,
+	const std::vector<std::string>& queries);
+
+// Runs the queries in parallel through the request queue, so that they are counted in its stats
+std::vector<std::vector<Document>> ProcessQueries(RequestQueue& request_queue,
 	const std::vector<std::string>& queries);
\ No newline at end of file
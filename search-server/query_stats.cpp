@@ -0,0 +1,108 @@
+#include "query_stats.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+size_t GetThreadShard() {
+	static atomic<size_t> next_shard{ 0 };
+	thread_local const size_t shard = next_shard.fetch_add(1, memory_order_relaxed) % QUERY_STATS_SHARD_COUNT;
+	return shard;
+}
+
+}  // namespace
+
+double QueryStatsSnapshot::GetQueriesPerSecond() const {
+	const double seconds = chrono::duration<double>(window).count();
+	return seconds > 0.0 ? query_count / seconds : 0.0;
+}
+
+double QueryStatsSnapshot::GetZeroResultRate() const {
+	return query_count > 0 ? static_cast<double>(zero_result_count) / query_count : 0.0;
+}
+
+double QueryStatsSnapshot::GetAverageResultCount() const {
+	return query_count > 0 ? static_cast<double>(result_count) / query_count : 0.0;
+}
+
+chrono::microseconds QueryStatsSnapshot::GetLatencyQuantile(double quantile) const {
+	return chrono::microseconds(latency_histogram.GetValueAtQuantile(quantile));
+}
+
+QueryStats::QueryStats(Clock::duration bucket_width, size_t bucket_count)
+	: bucket_width_(bucket_width)
+	, bucket_count_(bucket_count)
+	, start_(Clock::now())
+	, bucket_periods_(bucket_count)
+	, counters_(bucket_count * QUERY_STATS_SHARD_COUNT) {
+	if (bucket_width <= Clock::duration::zero() || bucket_count == 0) {
+		throw invalid_argument("Query stats need a positive bucket width and count"s);
+	}
+	for (auto& period : bucket_periods_) {
+		period.store(-1, memory_order_relaxed);
+	}
+}
+
+void QueryStats::Record(Clock::duration latency, size_t result_count, Clock::time_point now) {
+	const int64_t period = GetPeriod(now);
+	const size_t bucket = static_cast<size_t>(period) % bucket_count_;
+
+	int64_t bucket_period = bucket_periods_[bucket].load(memory_order_acquire);
+	if (bucket_period != period) {
+		if (bucket_period > period) {
+			// The query finished so late that its bucket already counts a newer period
+			return;
+		}
+		if (bucket_periods_[bucket].compare_exchange_strong(bucket_period, period, memory_order_acq_rel)) {
+			for (size_t shard = 0; shard < QUERY_STATS_SHARD_COUNT; ++shard) {
+				Counters& counters = counters_[bucket * QUERY_STATS_SHARD_COUNT + shard];
+				counters.query_count.store(0, memory_order_relaxed);
+				counters.zero_result_count.store(0, memory_order_relaxed);
+				counters.result_count.store(0, memory_order_relaxed);
+				counters.latency_histogram.Reset();
+			}
+		}
+		else if (bucket_period != period) {
+			return;
+		}
+	}
+
+	Counters& counters = counters_[bucket * QUERY_STATS_SHARD_COUNT + GetThreadShard()];
+	counters.query_count.fetch_add(1, memory_order_relaxed);
+	if (result_count == 0) {
+		counters.zero_result_count.fetch_add(1, memory_order_relaxed);
+	}
+	counters.result_count.fetch_add(result_count, memory_order_relaxed);
+	counters.latency_histogram.Record(static_cast<uint64_t>(max<int64_t>(chrono::duration_cast<chrono::microseconds>(latency).count(), 0)));
+}
+
+QueryStatsSnapshot QueryStats::GetSnapshot(Clock::duration window, Clock::time_point now) const {
+	const int64_t period = GetPeriod(now);
+	const int64_t window_buckets = (window + bucket_width_ - Clock::duration(1)) / bucket_width_;
+	const int64_t period_count = min<int64_t>(max<int64_t>(window_buckets, 1), static_cast<int64_t>(bucket_count_));
+
+	QueryStatsSnapshot snapshot;
+	snapshot.window = bucket_width_ * period_count;
+	for (int64_t counted_period = max<int64_t>(period - period_count + 1, 0); counted_period <= period; ++counted_period) {
+		const size_t bucket = static_cast<size_t>(counted_period) % bucket_count_;
+		if (bucket_periods_[bucket].load(memory_order_acquire) != counted_period) {
+			continue;
+		}
+		for (size_t shard = 0; shard < QUERY_STATS_SHARD_COUNT; ++shard) {
+			const Counters& counters = counters_[bucket * QUERY_STATS_SHARD_COUNT + shard];
+			snapshot.query_count += counters.query_count.load(memory_order_relaxed);
+			snapshot.zero_result_count += counters.zero_result_count.load(memory_order_relaxed);
+			snapshot.result_count += counters.result_count.load(memory_order_relaxed);
+			snapshot.latency_histogram.Add(counters.latency_histogram);
+		}
+	}
+	return snapshot;
+}
+
+int64_t QueryStats::GetPeriod(Clock::time_point time) const {
+	return time < start_ ? 0 : (time - start_) / bucket_width_;
+}
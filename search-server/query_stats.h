@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "hdr_histogram.h"
+
+// Latencies are kept to within about 6%, slower queries than about 71 minutes
+// share the last bucket. A histogram per shard and time bucket takes about 4 KB.
+const int LATENCY_HISTOGRAM_DIGITS = 1;
+const uint64_t LATENCY_HISTOGRAM_MAX_MICROSECONDS = uint64_t{ 1 } << 32;
+// Independent counter sets per time bucket. Threads pick one on their first query,
+// so concurrent queries rarely increment the same cache line.
+const size_t QUERY_STATS_SHARD_COUNT = 8;
+
+struct QueryStatsSnapshot {
+	std::chrono::steady_clock::duration window{};
+	uint64_t query_count = 0;
+	uint64_t zero_result_count = 0;
+	uint64_t result_count = 0;
+	// Query latencies in microseconds
+	HdrHistogram latency_histogram = HdrHistogram(LATENCY_HISTOGRAM_DIGITS, LATENCY_HISTOGRAM_MAX_MICROSECONDS);
+
+	double GetQueriesPerSecond() const;
+	double GetZeroResultRate() const;
+	double GetAverageResultCount() const;
+	// Highest latency of the given fraction of queries, to the histogram precision
+	std::chrono::microseconds GetLatencyQuantile(double quantile) const;
+};
+
+// Query counters in a ring of time buckets. Recording is lock-free and costs a few
+// relaxed atomic increments; reading merges the shards of the buckets in the window.
+// Increments racing with the reuse of a bucket for a new period may be lost.
+class QueryStats {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	explicit QueryStats(Clock::duration bucket_width = std::chrono::seconds(1), size_t bucket_count = 60);
+
+	void Record(Clock::duration latency, size_t result_count, Clock::time_point now = Clock::now());
+
+	// Totals of the last window, which is rounded up to whole buckets and capped by the ring length
+	QueryStatsSnapshot GetSnapshot(Clock::duration window, Clock::time_point now = Clock::now()) const;
+
+private:
+	struct alignas(64) Counters {
+		std::atomic<uint64_t> query_count{ 0 };
+		std::atomic<uint64_t> zero_result_count{ 0 };
+		std::atomic<uint64_t> result_count{ 0 };
+		HdrHistogram latency_histogram{ LATENCY_HISTOGRAM_DIGITS, LATENCY_HISTOGRAM_MAX_MICROSECONDS };
+	};
+
+	const Clock::duration bucket_width_;
+	const size_t bucket_count_;
+	const Clock::time_point start_;
+	// Period each bucket currently counts, -1 for never used
+	std::vector<std::atomic<int64_t>> bucket_periods_;
+	// QUERY_STATS_SHARD_COUNT counter sets per bucket
+	std::vector<Counters> counters_;
+
+	int64_t GetPeriod(Clock::time_point time) const;
+};
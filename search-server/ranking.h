@@ -0,0 +1,53 @@
+#pragma once
+
+#include "scoring.h"
+
+#include <cmath>
+#include <cstddef>
+
+enum class RankingModel {
+	TF_IDF,
+	BM25,
+};
+
+// Ranking models are passed to the scoring loops as template arguments, so every
+// model gets its own instantiation and nothing is called indirectly per posting
+
+struct TfIdfRanking {
+	double ComputeInverseDocumentFreq(int document_count, size_t document_freq) const {
+		return std::log(document_count * 1.0 / document_freq);
+	}
+
+	double ComputeScore(int, double term_freq, double inverse_document_freq) const {
+		return term_freq * inverse_document_freq;
+	}
+
+	void AccumulateScores(const int* slots, const double* term_freqs, size_t count,
+						  double inverse_document_freq, double* scores) const {
+		::AccumulateScores(slots, term_freqs, count, inverse_document_freq, scores);
+	}
+};
+
+struct Bm25Ranking {
+	Bm25Parameters parameters;
+	// Word counts indexed by document slot
+	const int* document_lengths;
+
+	// The Lucene variant of BM25 IDF, which never goes negative for common words
+	double ComputeInverseDocumentFreq(int document_count, size_t document_freq) const {
+		const double freq = static_cast<double>(document_freq);
+		return std::log(1 + (document_count - freq + 0.5) / (freq + 0.5));
+	}
+
+	double ComputeScore(int slot, double term_freq, double inverse_document_freq) const {
+		const double length = document_lengths[slot];
+		const double term_count = term_freq * length;
+		const double norm = parameters.k1 * (1 - parameters.b + parameters.b * length / parameters.average_document_length);
+		return inverse_document_freq * (parameters.k1 + 1) * term_count / (term_count + norm);
+	}
+
+	void AccumulateScores(const int* slots, const double* term_freqs, size_t count,
+						  double inverse_document_freq, double* scores) const {
+		AccumulateBm25Scores(slots, term_freqs, count, inverse_document_freq, parameters, document_lengths, scores);
+	}
+};
@@ -1,17 +1,17 @@
-#include <string>
-#include <iostream>
-
-using namespace std;
-
-string ReadLine() {
-	string s;
-	getline(cin, s);
-	return s;
-}
-
-int ReadLineWithNumber() {
-	int result;
-	cin >> result;
-	ReadLine();
-	return result;
+#include <string>
+#include <iostream>
+
+using namespace std;
+
+string ReadLine() {
+	string s;
+	getline(cin, s);
+	return s;
+}
+
+int ReadLineWithNumber() {
+	int result;
+	cin >> result;
+	ReadLine();
+	return result;
 }
\ No newline at end of file
@@ -1,7 +1,7 @@
-#pragma once
-
-#include <string>
-
-std::string ReadLine();
-
+#pragma once
+
+#include <string>
+
+std::string ReadLine();
+
 int ReadLineWithNumber();
\ No newline at end of file
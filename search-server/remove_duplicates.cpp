@@ -1,39 +1,158 @@
-#include <set>
-#include <string>
-#include <algorithm>
-
-#include "search_server.h"
-
-using namespace std;
-
-bool Equal(const map<string, double>& left, const map<string, double>& right) {
-	return left.size() == right.size()
-		&& equal(left.begin(), left.end(), right.begin(),
-			[](auto a, auto b) { return a.first == b.first; });
-}
-
-void RemoveDuplicates(SearchServer& search_server) {
-
-	set<int> duplicates;
-	set<string> found_words;
-
-	for (const int document_id : search_server) {
-
-		const auto& word_freqs = search_server.GetWordFrequencies(document_id);
-
-		string query;
-		for (const auto& [str, _] : word_freqs) {
-			query += string(str.data(), str.size()) + " "s;
-		}
-		if (found_words.count(query)) {
-			duplicates.insert(document_id);
-		} 
-		else {
-			found_words.insert(query);
-		}
-	}
-	for (auto id : duplicates) {
-		search_server.RemoveDocument(id);
-		cout << "Found duplicate document id "s << id << endl;
-	}
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include "minhash.h"
+#include "remove_duplicates.h"
+
+using namespace std;
+
+namespace {
+
+uint64_t HashTermIds(TermIds term_ids) {
+	uint64_t hash = MixBits(term_ids.size());
+	for (const int term_id : term_ids) {
+		hash = MixBits(hash ^ static_cast<uint32_t>(term_id));
+	}
+	return hash;
+}
+
+// Rows per LSH band for the given threshold. Two documents with similarity s share
+// a bucket in at least one of b bands with probability 1 - (1 - s^r)^b, which rises
+// steeply around (1 / b)^(1 / r). The largest r keeping that point at or below
+// min_similarity gives the fewest false candidates without losing the true ones.
+size_t ChooseBandRowCount(size_t signature_size, double min_similarity) {
+	size_t best_row_count = 1;
+	for (size_t row_count = 2; row_count <= signature_size; ++row_count) {
+		const double band_count = static_cast<double>(signature_size / row_count);
+		if (pow(1.0 / band_count, 1.0 / row_count) <= min_similarity) {
+			best_row_count = row_count;
+		}
+	}
+	return best_row_count;
+}
+
+class DisjointSets {
+public:
+	explicit DisjointSets(size_t size)
+		: parents_(size) {
+		iota(parents_.begin(), parents_.end(), 0);
+	}
+
+	size_t Find(size_t element) {
+		while (parents_[element] != element) {
+			parents_[element] = parents_[parents_[element]];
+			element = parents_[element];
+		}
+		return element;
+	}
+
+	void Unite(size_t lhs, size_t rhs) {
+		lhs = Find(lhs);
+		rhs = Find(rhs);
+		// The smaller index becomes the root, so every cluster is rooted at its smallest id
+		parents_[max(lhs, rhs)] = min(lhs, rhs);
+	}
+
+private:
+	vector<size_t> parents_;
+};
+
+}  // namespace
+
+vector<int> RemoveDuplicates(SearchServer& search_server) {
+	const vector<int> document_ids(search_server.begin(), search_server.end());
+
+	vector<uint64_t> hashes(document_ids.size());
+	transform(execution::par, document_ids.begin(), document_ids.end(), hashes.begin(), [&search_server](int document_id) {
+		return HashTermIds(search_server.GetDocumentTermIds(document_id));
+		});
+
+	// Documents with equal hashes are compared by their term ids, so collisions never remove a document
+	unordered_multimap<uint64_t, int> hash_to_document_id;
+	hash_to_document_id.reserve(document_ids.size());
+	vector<int> duplicates;
+	for (size_t i = 0; i < document_ids.size(); ++i) {
+		const TermIds term_ids = search_server.GetDocumentTermIds(document_ids[i]);
+		const auto [first, last] = hash_to_document_id.equal_range(hashes[i]);
+		const bool is_duplicate = any_of(first, last, [&search_server, &term_ids](const auto& entry) {
+			return search_server.GetDocumentTermIds(entry.second) == term_ids;
+			});
+		if (is_duplicate) {
+			duplicates.push_back(document_ids[i]);
+		}
+		else {
+			hash_to_document_id.emplace(hashes[i], document_ids[i]);
+		}
+	}
+
+	search_server.RemoveDocuments(duplicates);
+	for (const int id : duplicates) {
+		cout << "Found duplicate document id "s << id << '\n';
+	}
+	cout.flush();
+	return duplicates;
+}
+
+vector<vector<int>> FindNearDuplicates(const SearchServer& search_server, double min_similarity) {
+	const size_t signature_size = search_server.GetOptions().minhash_signature_size;
+	if (signature_size == 0) {
+		throw invalid_argument("Search server keeps no MinHash signatures"s);
+	}
+	if (!(min_similarity > 0.0 && min_similarity <= 1.0)) {
+		throw invalid_argument("Similarity threshold must be in (0, 1]"s);
+	}
+
+	const vector<int> document_ids(search_server.begin(), search_server.end());
+	const size_t row_count = ChooseBandRowCount(signature_size, min_similarity);
+	const size_t band_count = signature_size / row_count;
+
+	DisjointSets clusters(document_ids.size());
+	const auto is_near_duplicate = [&](size_t lhs, size_t rhs) {
+		return ComputeJaccardSimilarity(search_server.GetDocumentTermIds(document_ids[lhs]), 
+										search_server.GetDocumentTermIds(document_ids[rhs])) >= min_similarity;
+	};
+
+	for (size_t band = 0; band < band_count; ++band) {
+		unordered_map<uint64_t, vector<size_t>> buckets;
+		for (size_t i = 0; i < document_ids.size(); ++i) {
+			const auto& signature = search_server.GetMinHashSignature(document_ids[i]);
+			uint64_t band_hash = band;
+			for (size_t row = band * row_count; row < (band + 1) * row_count; ++row) {
+				band_hash = MixBits(band_hash ^ signature[row]);
+			}
+			buckets[band_hash].push_back(i);
+		}
+
+		// Every bucket member is compared with the earlier members of other clusters, so
+		// chains of similar documents join whatever their order, and copies are compared once
+		for (const auto& [_, members] : buckets) {
+			for (size_t i = 1; i < members.size(); ++i) {
+				for (size_t j = 0; j < i; ++j) {
+					if (clusters.Find(members[j]) != clusters.Find(members[i]) && is_near_duplicate(members[j], members[i])) {
+						clusters.Unite(members[j], members[i]);
+					}
+				}
+			}
+		}
+	}
+
+	map<size_t, vector<int>> root_to_cluster;
+	for (size_t i = 0; i < document_ids.size(); ++i) {
+		root_to_cluster[clusters.Find(i)].push_back(document_ids[i]);
+	}
+	vector<vector<int>> near_duplicates;
+	for (auto& [_, cluster] : root_to_cluster) {
+		if (cluster.size() > 1) {
+			near_duplicates.push_back(move(cluster));
+		}
+	}
+	return near_duplicates;
 }
\ No newline at end of file
@@ -1,5 +1,14 @@
-#pragma once
-
-#include "search_server.h"
-
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+#pragma once
+
+#include "search_server.h"
+
+// Removes every document with the same set of words as a document with a smaller id.
+// Returns the removed ids in ascending order.
+std::vector<int> RemoveDuplicates(SearchServer& search_server);
+
+// Clusters of documents whose word sets have a Jaccard similarity of at least
+// min_similarity to some other document of the same cluster. Candidate pairs come
+// from LSH banding of the MinHash signatures, which the server keeps only when
+// created with minhash_signature_size > 0, and are confirmed with the exact similarity.
+// Nothing is removed. Clusters are sorted, and ordered by their smallest id.
+std::vector<std::vector<int>> FindNearDuplicates(const SearchServer& search_server, double min_similarity);
\ No newline at end of file
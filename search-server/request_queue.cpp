@@ -1,39 +1,39 @@
-#include "request_queue.h"
-
-using namespace std;
-
-RequestQueue::RequestQueue(const SearchServer& search_server) : search_server_(search_server) {
-}
-
-vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status) {
-	vector<Document> found_documents = search_server_.FindTopDocuments(raw_query, status);
-	AddFindRequest(found_documents);
-	return found_documents;
-}
-
-vector<Document> RequestQueue::AddFindRequest(const string& raw_query) {
-	vector<Document> found_documents = search_server_.FindTopDocuments(raw_query);
-	AddFindRequest(found_documents);
-	return found_documents;
-}
-
-int RequestQueue::GetNoResultRequests() const {
-	return no_result_request_count_;
-}
-
-void RequestQueue::AddFindRequest(const vector<Document>& found_documents) {
-	if (found_documents.empty()) {
-		++no_result_request_count_;
-		requests_.push_back(true);
-	}
-	else {
-		requests_.push_back(false);
-	}
-
-	if (requests_.size() > sec_in_day_) {
-		if (requests_.front().empty_) {
-			--no_result_request_count_;
-		}
-		requests_.pop_front();
-	}
+#include "request_queue.h"
+
+using namespace std;
+
+RequestQueue::RequestQueue(const SearchServer& search_server) : search_server_(search_server) {
+}
+
+vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status) {
+	const auto start_time = QueryStats::Clock::now();
+	vector<Document> found_documents = search_server_.FindTopDocuments(raw_query, status);
+	AddFindRequest(found_documents, start_time);
+	return found_documents;
+}
+
+vector<Document> RequestQueue::AddFindRequest(const string& raw_query) {
+	const auto start_time = QueryStats::Clock::now();
+	vector<Document> found_documents = search_server_.FindTopDocuments(raw_query);
+	AddFindRequest(found_documents, start_time);
+	return found_documents;
+}
+
+int RequestQueue::GetNoResultRequests() const {
+	return no_result_request_count_.load(memory_order_relaxed);
+}
+
+QueryStatsSnapshot RequestQueue::GetStats(QueryStats::Clock::duration window) const {
+	return stats_.GetSnapshot(window);
+}
+
+void RequestQueue::AddFindRequest(const vector<Document>& found_documents, QueryStats::Clock::time_point start_time) {
+	const auto now = QueryStats::Clock::now();
+	stats_.Record(now - start_time, found_documents.size(), now);
+
+	// The request takes the slot of the one sec_in_day_ requests older
+	const size_t slot = request_count_.fetch_add(1, memory_order_relaxed) % sec_in_day_;
+	const bool no_result = found_documents.empty();
+	const bool replaced_no_result = no_result_requests_[slot].exchange(no_result, memory_order_relaxed);
+	no_result_request_count_.fetch_add(static_cast<int>(no_result) - static_cast<int>(replaced_no_result), memory_order_relaxed);
 }
\ No newline at end of file
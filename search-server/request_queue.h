@@ -1,39 +1,46 @@
-#pragma once
-
-#include <vector>
-#include <deque>
-
-#include "search_server.h"
-#include "document.h"
-
-class RequestQueue {
-public:
-	explicit RequestQueue(const SearchServer& search_server);
-
-	template <typename DocumentPredicate>
-	std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
-
-	std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
-
-	std::vector<Document> AddFindRequest(const std::string& raw_query);
-
-	int GetNoResultRequests() const;
-private:
-	struct QueryResult {
-		QueryResult(bool empty) : empty_(empty) {}
-		bool empty_;
-	};
-	std::deque<QueryResult> requests_;
-	const static int sec_in_day_ = 1440;
-	const SearchServer& search_server_;
-	size_t no_result_request_count_ = 0;
-
-	void AddFindRequest(const std::vector<Document>& found_documents);
-};
-
-template <typename DocumentPredicate>
-std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-	std::vector<Document> found_documents = search_server_.FindTopDocuments(raw_query, document_predicate);
-	AddFindRequest(found_documents);
-	return found_documents;
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "search_server.h"
+#include "document.h"
+#include "query_stats.h"
+
+// Runs queries and keeps their statistics. Safe to use from many threads at once.
+class RequestQueue {
+public:
+	explicit RequestQueue(const SearchServer& search_server);
+
+	template <typename DocumentPredicate>
+	std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
+
+	std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
+
+	std::vector<Document> AddFindRequest(const std::string& raw_query);
+
+	// Requests without results among the last sec_in_day_ ones
+	int GetNoResultRequests() const;
+
+	QueryStatsSnapshot GetStats(QueryStats::Clock::duration window) const;
+private:
+	const static int sec_in_day_ = 1440;
+	const SearchServer& search_server_;
+	// Whether each of the last sec_in_day_ requests found nothing, as a ring
+	std::array<std::atomic<bool>, sec_in_day_> no_result_requests_ = {};
+	std::atomic<uint64_t> request_count_{ 0 };
+	std::atomic<int> no_result_request_count_{ 0 };
+	QueryStats stats_;
+
+	void AddFindRequest(const std::vector<Document>& found_documents, QueryStats::Clock::time_point start_time);
+};
+
+template <typename DocumentPredicate>
+std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
+	const auto start_time = QueryStats::Clock::now();
+	std::vector<Document> found_documents = search_server_.FindTopDocuments(raw_query, document_predicate);
+	AddFindRequest(found_documents, start_time);
+	return found_documents;
 }
\ No newline at end of file
@@ -0,0 +1,428 @@
+#include "scoring.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SCORING_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define SCORING_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SCORING_TARGET(isa)
+#endif
+
+using namespace std;
+
+namespace {
+
+// BM25 = idf * (k1 + 1) * count / (count + k1 * (1 - b) + k1 * b / avgdl * length),
+// with everything that does not depend on the posting folded in once per call
+struct Bm25Constants {
+	double numerator_factor;
+	double length_free_norm;
+	double length_norm;
+};
+
+Bm25Constants MakeBm25Constants(double inverse_document_freq, const Bm25Parameters& parameters) {
+	return {
+		inverse_document_freq * (parameters.k1 + 1),
+		parameters.k1 * (1 - parameters.b),
+		parameters.k1 * parameters.b / parameters.average_document_length,
+	};
+}
+
+// Postings ahead of the current one whose score slot, and length, are prefetched
+constexpr size_t SLOT_PREFETCH_DISTANCE = 16;
+// Postings ahead of the current one whose block of the posting arrays is prefetched.
+// Hardware prefetchers stop at page boundaries, software prefetches do not.
+constexpr size_t BLOCK_PREFETCH_DISTANCE = 256;
+
+void PrefetchForRead(const void* p) {
+#if defined(__GNUC__)
+	__builtin_prefetch(p, 0);
+#elif defined(SCORING_X86)
+	_mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#endif
+}
+
+void PrefetchForWrite(const void* p) {
+#if defined(__GNUC__)
+	__builtin_prefetch(p, 1);
+#elif defined(SCORING_X86)
+	_mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#endif
+}
+
+// Prefetches what the postings [first, last) will touch a few iterations from now:
+// the score slots and the lengths of the documents, and the next block of the
+// posting arrays once per cache line of term frequencies
+void PrefetchPostings(const int* slots, const double* term_freqs, size_t count, size_t first, size_t last,
+					  const int* document_lengths, double* scores) {
+	for (size_t i = first + SLOT_PREFETCH_DISTANCE; i < last + SLOT_PREFETCH_DISTANCE && i < count; ++i) {
+		PrefetchForWrite(scores + slots[i]);
+		if (document_lengths != nullptr) {
+			PrefetchForRead(document_lengths + slots[i]);
+		}
+	}
+	for (size_t i = (first + 7) / 8 * 8; i < last; i += 8) {
+		if (i + BLOCK_PREFETCH_DISTANCE < count) {
+			PrefetchForRead(slots + i + BLOCK_PREFETCH_DISTANCE);
+			PrefetchForRead(term_freqs + i + BLOCK_PREFETCH_DISTANCE);
+		}
+	}
+}
+
+using AccumulateScoresFunction = void (*)(const int*, const double*, size_t, double, double*);
+using AccumulateBm25ScoresFunction = void (*)(const int*, const double*, size_t, const Bm25Constants&, const int*, double*);
+using CollectScoredDocumentsFunction = void (*)(const double*, int, int, vector<int>&);
+
+struct ScoringKernels {
+	ScoringIsa isa;
+	bool prefetch;
+	AccumulateScoresFunction accumulate_scores;
+	AccumulateBm25ScoresFunction accumulate_bm25_scores;
+	CollectScoredDocumentsFunction collect_scored_documents;
+};
+
+template <bool Prefetch>
+void AccumulateScoresScalar(const int* slots, const double* term_freqs, size_t count,
+							double inverse_document_freq, double* scores) {
+	for (size_t i = 0; i < count; ++i) {
+		if constexpr (Prefetch) {
+			PrefetchPostings(slots, term_freqs, count, i, i + 1, nullptr, scores);
+		}
+		scores[slots[i]] += term_freqs[i] * inverse_document_freq;
+	}
+}
+
+template <bool Prefetch>
+void AccumulateBm25ScoresScalar(const int* slots, const double* term_freqs, size_t count,
+								const Bm25Constants& constants, const int* document_lengths, double* scores) {
+	for (size_t i = 0; i < count; ++i) {
+		if constexpr (Prefetch) {
+			PrefetchPostings(slots, term_freqs, count, i, i + 1, document_lengths, scores);
+		}
+		const double length = document_lengths[slots[i]];
+		const double term_count = term_freqs[i] * length;
+		const double norm = constants.length_free_norm + constants.length_norm * length;
+		scores[slots[i]] += constants.numerator_factor * term_count / (term_count + norm);
+	}
+}
+
+void CollectScoredDocumentsScalar(const double* scores, int first_slot, int last_slot,
+								  vector<int>& slots) {
+	for (int slot = first_slot; slot < last_slot; ++slot) {
+		if (!signbit(scores[slot])) {
+			slots.push_back(slot);
+		}
+	}
+}
+
+#ifdef SCORING_X86
+
+int CountTrailingZeros(unsigned value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long index;
+	_BitScanForward(&index, value);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctz(value);
+#endif
+}
+
+// Gathers start from zeroed registers with every lane enabled and the int to
+// double conversion is zero-masked: the unmasked intrinsics leave an operand
+// undefined, which GCC reports as used uninitialized
+SCORING_TARGET("avx2")
+__m256d GatherDoubles(const double* base, __m128i indexes) {
+	return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, indexes, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), 8);
+}
+
+SCORING_TARGET("avx2")
+__m128i GatherInts(const int* base, __m128i indexes) {
+	return _mm_mask_i32gather_epi32(_mm_setzero_si128(), base, indexes, _mm_set1_epi32(-1), 4);
+}
+
+SCORING_TARGET("avx2")
+__m256i GatherInts(const int* base, __m256i indexes) {
+	return _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), base, indexes, _mm256_set1_epi32(-1), 4);
+}
+
+SCORING_TARGET("avx512f")
+__m512d GatherDoubles(const double* base, __m256i indexes) {
+	return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, indexes, base, 8);
+}
+
+// AVX2 has gathers but no scatters: the products are computed four at a time
+// and stored back one by one, which is still cheaper than four scalar multiplies
+template <bool Prefetch>
+SCORING_TARGET("avx2")
+void AccumulateScoresAvx2(const int* slots, const double* term_freqs, size_t count,
+						  double inverse_document_freq, double* scores) {
+	const __m256d idf = _mm256_set1_pd(inverse_document_freq);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		if constexpr (Prefetch) {
+			PrefetchPostings(slots, term_freqs, count, i, i + 4, nullptr, scores);
+		}
+		const __m128i ids = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots + i));
+		const __m256d current = GatherDoubles(scores, ids);
+		const __m256d sum = _mm256_add_pd(current, _mm256_mul_pd(_mm256_loadu_pd(term_freqs + i), idf));
+
+		alignas(32) double sums[4];
+		_mm256_store_pd(sums, sum);
+		scores[slots[i]] = sums[0];
+		scores[slots[i + 1]] = sums[1];
+		scores[slots[i + 2]] = sums[2];
+		scores[slots[i + 3]] = sums[3];
+	}
+	AccumulateScoresScalar<Prefetch>(slots + i, term_freqs + i, count - i, inverse_document_freq, scores);
+}
+
+template <bool Prefetch>
+SCORING_TARGET("avx2")
+void AccumulateBm25ScoresAvx2(const int* slots, const double* term_freqs, size_t count,
+							  const Bm25Constants& constants, const int* document_lengths, double* scores) {
+	const __m256d numerator_factor = _mm256_set1_pd(constants.numerator_factor);
+	const __m256d length_free_norm = _mm256_set1_pd(constants.length_free_norm);
+	const __m256d length_norm = _mm256_set1_pd(constants.length_norm);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		if constexpr (Prefetch) {
+			PrefetchPostings(slots, term_freqs, count, i, i + 4, document_lengths, scores);
+		}
+		const __m128i ids = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots + i));
+		const __m256d length = _mm256_cvtepi32_pd(GatherInts(document_lengths, ids));
+		const __m256d term_count = _mm256_mul_pd(_mm256_loadu_pd(term_freqs + i), length);
+		const __m256d norm = _mm256_add_pd(length_free_norm, _mm256_mul_pd(length_norm, length));
+		const __m256d score = _mm256_div_pd(_mm256_mul_pd(numerator_factor, term_count), _mm256_add_pd(term_count, norm));
+		const __m256d sum = _mm256_add_pd(GatherDoubles(scores, ids), score);
+
+		alignas(32) double sums[4];
+		_mm256_store_pd(sums, sum);
+		scores[slots[i]] = sums[0];
+		scores[slots[i + 1]] = sums[1];
+		scores[slots[i + 2]] = sums[2];
+		scores[slots[i + 3]] = sums[3];
+	}
+	AccumulateBm25ScoresScalar<Prefetch>(slots + i, term_freqs + i, count - i, constants, document_lengths, scores);
+}
+
+SCORING_TARGET("avx2")
+void CollectScoredDocumentsAvx2(const double* scores, int first_slot, int last_slot,
+								vector<int>& slots) {
+	int slot = first_slot;
+	for (; slot + 4 <= last_slot; slot += 4) {
+		// movemask gathers the sign bits, set bits are UNSCORED slots
+		unsigned scored = ~_mm256_movemask_pd(_mm256_loadu_pd(scores + slot)) & 0xFu;
+		while (scored != 0) {
+			const int lane = CountTrailingZeros(scored);
+			slots.push_back(slot + lane);
+			scored &= scored - 1;
+		}
+	}
+	CollectScoredDocumentsScalar(scores, slot, last_slot, slots);
+}
+
+template <bool Prefetch>
+SCORING_TARGET("avx512f")
+void AccumulateScoresAvx512(const int* slots, const double* term_freqs, size_t count,
+							double inverse_document_freq, double* scores) {
+	const __m512d idf = _mm512_set1_pd(inverse_document_freq);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		if constexpr (Prefetch) {
+			PrefetchPostings(slots, term_freqs, count, i, i + 8, nullptr, scores);
+		}
+		const __m256i ids = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots + i));
+		const __m512d current = GatherDoubles(scores, ids);
+		const __m512d sum = _mm512_add_pd(current, _mm512_mul_pd(_mm512_loadu_pd(term_freqs + i), idf));
+		_mm512_i32scatter_pd(scores, ids, sum, 8);
+	}
+	AccumulateScoresScalar<Prefetch>(slots + i, term_freqs + i, count - i, inverse_document_freq, scores);
+}
+
+template <bool Prefetch>
+SCORING_TARGET("avx512f")
+void AccumulateBm25ScoresAvx512(const int* slots, const double* term_freqs, size_t count,
+								const Bm25Constants& constants, const int* document_lengths, double* scores) {
+	const __m512d numerator_factor = _mm512_set1_pd(constants.numerator_factor);
+	const __m512d length_free_norm = _mm512_set1_pd(constants.length_free_norm);
+	const __m512d length_norm = _mm512_set1_pd(constants.length_norm);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		if constexpr (Prefetch) {
+			PrefetchPostings(slots, term_freqs, count, i, i + 8, document_lengths, scores);
+		}
+		const __m256i ids = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots + i));
+		const __m512d length = _mm512_maskz_cvtepi32_pd(0xFF, GatherInts(document_lengths, ids));
+		const __m512d term_count = _mm512_mul_pd(_mm512_loadu_pd(term_freqs + i), length);
+		const __m512d norm = _mm512_add_pd(length_free_norm, _mm512_mul_pd(length_norm, length));
+		const __m512d score = _mm512_div_pd(_mm512_mul_pd(numerator_factor, term_count), _mm512_add_pd(term_count, norm));
+		_mm512_i32scatter_pd(scores, ids, _mm512_add_pd(GatherDoubles(scores, ids), score), 8);
+	}
+	AccumulateBm25ScoresScalar<Prefetch>(slots + i, term_freqs + i, count - i, constants, document_lengths, scores);
+}
+
+SCORING_TARGET("avx512f")
+void CollectScoredDocumentsAvx512(const double* scores, int first_slot, int last_slot,
+								  vector<int>& slots) {
+	const __m512i zero = _mm512_setzero_si512();
+	int slot = first_slot;
+	for (; slot + 8 <= last_slot; slot += 8) {
+		// A clear sign bit means the score reads as a non-negative 64-bit integer
+		const __m512i bits = _mm512_castpd_si512(_mm512_loadu_pd(scores + slot));
+		unsigned scored = _mm512_cmpge_epi64_mask(bits, zero);
+		while (scored != 0) {
+			const int lane = CountTrailingZeros(scored);
+			slots.push_back(slot + lane);
+			scored &= scored - 1;
+		}
+	}
+	CollectScoredDocumentsScalar(scores, slot, last_slot, slots);
+}
+
+bool CpuSupports(ScoringIsa isa) {
+#if defined(__GNUC__)
+	__builtin_cpu_init();
+	switch (isa) {
+	case ScoringIsa::AVX512:
+		return __builtin_cpu_supports("avx512f");
+	case ScoringIsa::AVX2:
+		return __builtin_cpu_supports("avx2");
+	default:
+		return true;
+	}
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return isa == ScoringIsa::SCALAR;
+	}
+	__cpuid(info, 1);
+	const bool os_saves_ymm = (info[2] & (1 << 27)) && ((_xgetbv(0) & 0x6) == 0x6);
+	__cpuidex(info, 7, 0);
+	switch (isa) {
+	case ScoringIsa::AVX512:
+		return os_saves_ymm && (info[1] & (1 << 16)) && ((_xgetbv(0) & 0xE6) == 0xE6);
+	case ScoringIsa::AVX2:
+		return os_saves_ymm && (info[1] & (1 << 5));
+	default:
+		return true;
+	}
+#else
+	return isa == ScoringIsa::SCALAR;
+#endif
+}
+
+#else
+
+bool CpuSupports(ScoringIsa isa) {
+	return isa == ScoringIsa::SCALAR;
+}
+
+#endif
+
+const ScoringKernels SCALAR_KERNELS[] = { 
+	{ ScoringIsa::SCALAR, false, AccumulateScoresScalar<false>, AccumulateBm25ScoresScalar<false>, CollectScoredDocumentsScalar },
+	{ ScoringIsa::SCALAR, true, AccumulateScoresScalar<true>, AccumulateBm25ScoresScalar<true>, CollectScoredDocumentsScalar },
+};
+#ifdef SCORING_X86
+const ScoringKernels AVX2_KERNELS[] = { 
+	{ ScoringIsa::AVX2, false, AccumulateScoresAvx2<false>, AccumulateBm25ScoresAvx2<false>, CollectScoredDocumentsAvx2 },
+	{ ScoringIsa::AVX2, true, AccumulateScoresAvx2<true>, AccumulateBm25ScoresAvx2<true>, CollectScoredDocumentsAvx2 },
+};
+const ScoringKernels AVX512_KERNELS[] = { 
+	{ ScoringIsa::AVX512, false, AccumulateScoresAvx512<false>, AccumulateBm25ScoresAvx512<false>, CollectScoredDocumentsAvx512 },
+	{ ScoringIsa::AVX512, true, AccumulateScoresAvx512<true>, AccumulateBm25ScoresAvx512<true>, CollectScoredDocumentsAvx512 },
+};
+#endif
+
+const ScoringKernels* GetKernels(ScoringIsa isa, bool prefetch) {
+	switch (isa) {
+#ifdef SCORING_X86
+	case ScoringIsa::AVX512:
+		return &AVX512_KERNELS[prefetch];
+	case ScoringIsa::AVX2:
+		return &AVX2_KERNELS[prefetch];
+#endif
+	default:
+		return &SCALAR_KERNELS[prefetch];
+	}
+}
+
+atomic<const ScoringKernels*>& ActiveKernels() {
+	static atomic<const ScoringKernels*> kernels = GetKernels(GetSupportedScoringIsa(), true);
+	return kernels;
+}
+
+}  // namespace
+
+ScoringIsa GetSupportedScoringIsa() {
+	static const ScoringIsa isa = [] {
+		for (ScoringIsa candidate : { ScoringIsa::AVX512, ScoringIsa::AVX2 }) {
+			if (CpuSupports(candidate)) {
+				return candidate;
+			}
+		}
+		return ScoringIsa::SCALAR;
+	}();
+	return isa;
+}
+
+ScoringIsa GetScoringIsa() {
+	return ActiveKernels().load(memory_order_relaxed)->isa;
+}
+
+void SetScoringIsa(ScoringIsa isa) {
+	if (!CpuSupports(isa)) {
+		using namespace std::literals::string_literals;
+		throw invalid_argument("Scoring instruction set "s + string(GetScoringIsaName(isa)) + " is not supported"s);
+	}
+	ActiveKernels().store(GetKernels(isa, GetScoringPrefetch()), memory_order_relaxed);
+}
+
+bool GetScoringPrefetch() {
+	return ActiveKernels().load(memory_order_relaxed)->prefetch;
+}
+
+void SetScoringPrefetch(bool prefetch) {
+	ActiveKernels().store(GetKernels(GetScoringIsa(), prefetch), memory_order_relaxed);
+}
+
+string_view GetScoringIsaName(ScoringIsa isa) {
+	switch (isa) {
+	case ScoringIsa::AVX512:
+		return "avx512";
+	case ScoringIsa::AVX2:
+		return "avx2";
+	default:
+		return "scalar";
+	}
+}
+
+void AccumulateScores(const int* slots, const double* term_freqs, size_t count,
+					  double inverse_document_freq, double* scores) {
+	ActiveKernels().load(memory_order_relaxed)->accumulate_scores(slots, term_freqs, count, inverse_document_freq, scores);
+}
+
+void AccumulateBm25Scores(const int* slots, const double* term_freqs, size_t count,
+						  double inverse_document_freq, const Bm25Parameters& parameters,
+						  const int* document_lengths, double* scores) {
+	ActiveKernels().load(memory_order_relaxed)->accumulate_bm25_scores(slots, term_freqs, count, 
+		MakeBm25Constants(inverse_document_freq, parameters), document_lengths, scores);
+}
+
+void CollectScoredDocuments(const double* scores, int first_slot, int last_slot,
+							vector<int>& slots) {
+	ActiveKernels().load(memory_order_relaxed)->collect_scored_documents(scores, first_slot, last_slot, slots);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// Dense score buffers are indexed by document slot. Untouched slots hold -0.0:
+// adding any non-negative contribution clears the sign bit, so a slot is scored
+// exactly when its sign bit is clear, even if its relevance is zero.
+constexpr double UNSCORED = -0.0;
+
+enum class ScoringIsa {
+	SCALAR,
+	AVX2,
+	AVX512,
+};
+
+// The best instruction set supported by the CPU, detected once at runtime
+ScoringIsa GetSupportedScoringIsa();
+
+ScoringIsa GetScoringIsa();
+
+// Overrides the kernels used by AccumulateScores and CollectScoredDocuments.
+// Meant for benchmarks and tests, not to be called while queries are running.
+void SetScoringIsa(ScoringIsa isa);
+
+std::string_view GetScoringIsaName(ScoringIsa isa);
+
+bool GetScoringPrefetch();
+
+// Switches the software prefetches of AccumulateScores on or off, they are on by
+// default. Same restrictions as SetScoringIsa.
+void SetScoringPrefetch(bool prefetch);
+
+// scores[slots[i]] += term_freqs[i] * inverse_document_freq.
+// Slots must be unique within one call, as they are in a posting list.
+void AccumulateScores(const int* slots, const double* term_freqs, size_t count,
+					  double inverse_document_freq, double* scores);
+
+struct Bm25Parameters {
+	double k1;
+	double b;
+	double average_document_length;
+};
+
+// scores[slot] += BM25 of the posting, where slot = slots[i] and the raw term
+// count is recovered as term_freqs[i] * document_lengths[slot]
+void AccumulateBm25Scores(const int* slots, const double* term_freqs, size_t count,
+						  double inverse_document_freq, const Bm25Parameters& parameters,
+						  const int* document_lengths, double* scores);
+
+// Appends the slots in [first_slot, last_slot) whose score is not UNSCORED
+void CollectScoredDocuments(const double* scores, int first_slot, int last_slot,
+							std::vector<int>& slots);
@@ -1,132 +1,850 @@
-#include "search_server.h"
-#include "log_duration.h"
-
-#include <algorithm>
-#include <map>
-#include <set>
-#include <string>
-#include <vector>
-#include <cmath>
-#include <execution>
-
-using namespace std;
-
-SearchServer::SearchServer(string_view stop_words_text)
-	: SearchServer(SplitIntoWords(stop_words_text))  
-													 
-{
-}
-
-SearchServer::SearchServer(const string& stop_words_text)
-	: SearchServer(SplitIntoWords(stop_words_text))
-
-{
-}
-
-void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
-	if ((document_id < 0) || (documents_.count(document_id) > 0)) {
-		throw invalid_argument("Invalid document_id"s);
-	}
-	const auto words = SplitIntoWordsNoStopAndAddWords(document);
-
-	const double inv_word_count = 1.0 / words.size();
-	for (string_view word : words) {
-		word_to_document_freqs_[word][document_id] += inv_word_count;
-		document_to_word_freqs_[document_id][word] += inv_word_count;
-	}
-	documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status });
-	document_ids_.insert(document_id);
-}
-
-vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
-	return FindTopDocuments(execution::seq, raw_query, status);
-}
-
-vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
-	return FindTopDocuments(execution::seq, raw_query);
-}
-
-int SearchServer::GetDocumentCount() const {
-	return documents_.size();
-}
-
-set<int>::const_iterator SearchServer::begin() const {
-	return document_ids_.begin();
-}
-
-set<int>::const_iterator SearchServer::end() const {
-	return document_ids_.end();
-}
-
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const {
-	return MatchDocument(execution::seq, raw_query, document_id);
-}
-
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-
-	if (document_to_word_freqs_.find(document_id) == document_to_word_freqs_.end()) {
-		static map<string_view, double> empty_result;
-		return empty_result;
-	}
-	return document_to_word_freqs_.at(document_id);
-}
-
-void SearchServer::RemoveDocument(int document_id) {
-	RemoveDocument(execution::seq, document_id);
-}
-
-bool SearchServer::IsStopWord(std::string_view word) const {
-	return stop_words_.count(word) > 0;
-}
-
-bool SearchServer::IsValidWord(std::string_view word) {
-	// A valid word must not contain special characters
-	return none_of(word.begin(), word.end(), [](char c) {
-		return c >= '\0' && c < ' ';
-		});
-}
-
-vector<string_view> SearchServer::SplitIntoWordsNoStopAndAddWords(string_view text) {
-	vector<string_view> words;
-	for (string_view word : SplitIntoWords(text)) {
-		if (!IsValidWord(word)) {
-			throw invalid_argument("Word "s + string(word.data(), word.size()) + " is invalid"s);
-		}
-		if (!IsStopWord(word)) {
-			words.push_back(*(words_.insert(string(word))).first);
-		}
-	}
-	return words;
-}
-
-int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
-	if (ratings.empty()) {
-		return 0;
-	}
-	int rating_sum = 0;
-	for (const int rating : ratings) {
-		rating_sum += rating;
-	}
-	return rating_sum / static_cast<int>(ratings.size());
-}
-
-SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
-	if (text.empty()) {
-		throw invalid_argument("Query word is empty"s);
-	}
-
-	bool is_minus = false;
-	if (text[0] == '-') {
-		is_minus = true;
-		text = text.substr(1, text.size() - 1);
-	}
-	if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
-		throw invalid_argument("Query word "s + string(text.data(), text.size()) + " is invalid");
-	}
-
-	return { text, is_minus, IsStopWord(text) };
-}
-
-double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
-	return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+#include "search_server.h"
+#include "log_duration.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <charconv>
+#include <execution>
+#include <iterator>
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+// Color, parent and two children of a red-black tree node, ahead of its value
+constexpr size_t MAP_NODE_OVERHEAD = 4 * sizeof(void*);
+
+// Bytes of the string kept outside of the string object, none for short strings
+size_t GetHeapMemoryUsage(const string& text) {
+	const char* const object = reinterpret_cast<const char*>(&text);
+	const bool is_on_heap = text.data() < object || text.data() >= object + sizeof(text);
+	return is_on_heap ? text.capacity() + 1 : 0;
+}
+
+// Recognizes the NEAR/k operator of positional queries
+bool ParseNearOperator(string_view token, int& max_distance) {
+	const string_view prefix = "NEAR/"sv;
+	if (token.size() <= prefix.size() || token.size() > prefix.size() + 9 || token.substr(0, prefix.size()) != prefix) {
+		return false;
+	}
+	max_distance = 0;
+	for (const char c : token.substr(prefix.size())) {
+		if (c < '0' || c > '9') {
+			return false;
+		}
+		max_distance = max_distance * 10 + (c - '0');
+	}
+	return true;
+}
+
+bool AreWithinDistance(const vector<int>& lhs, const vector<int>& rhs, int max_distance) {
+	size_t i = 0;
+	size_t j = 0;
+	while (i < lhs.size() && j < rhs.size()) {
+		if (abs(lhs[i] - rhs[j]) <= max_distance) {
+			return true;
+		}
+		if (lhs[i] < rhs[j]) {
+			++i;
+		}
+		else {
+			++j;
+		}
+	}
+	return false;
+}
+
+}  // namespace
+
+SearchCursor MakeSearchCursor(const Document& document) {
+	return { document.relevance, document.rating, document.id };
+}
+
+string EncodeSearchCursor(const SearchCursor& cursor) {
+	// The relevance goes by its bit pattern, so that decoding gives back the exact value
+	uint64_t relevance_bits;
+	memcpy(&relevance_bits, &cursor.relevance, sizeof(relevance_bits));
+	return to_string(relevance_bits) + ':' + to_string(cursor.rating) + ':' + to_string(cursor.document_id);
+}
+
+SearchCursor DecodeSearchCursor(string_view text) {
+	uint64_t relevance_bits = 0;
+	SearchCursor cursor;
+	const char* const last = text.data() + text.size();
+	auto result = from_chars(text.data(), last, relevance_bits);
+	if (result.ec == errc{} && result.ptr != last && *result.ptr == ':') {
+		result = from_chars(result.ptr + 1, last, cursor.rating);
+		if (result.ec == errc{} && result.ptr != last && *result.ptr == ':') {
+			result = from_chars(result.ptr + 1, last, cursor.document_id);
+			if (result.ec == errc{} && result.ptr == last) {
+				memcpy(&cursor.relevance, &relevance_bits, sizeof(relevance_bits));
+				return cursor;
+			}
+		}
+	}
+	throw invalid_argument("Search cursor "s + string(text) + " is invalid"s);
+}
+
+SearchServer::SearchServer(string_view stop_words_text, const SearchServerOptions& options)
+	: SearchServer(SplitIntoWords(stop_words_text), options)  
+													 
+{
+}
+
+SearchServer::SearchServer(const string& stop_words_text, const SearchServerOptions& options)
+	: SearchServer(SplitIntoWords(stop_words_text), options)
+
+{
+}
+
+void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+	if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+		throw invalid_argument("Invalid document_id"s);
+	}
+	TokenizedDocument tokenized;
+	TokenizeDocument(document, tokenized);
+	AddDocumentWords(document_id, tokenized.words, tokenized.positions, status, ratings);
+}
+
+void SearchServer::TokenizeDocument(string_view document, TokenizedDocument& tokenized) const {
+	tokenized.words.clear();
+	tokenized.positions.clear();
+	int position = 0;
+	for (string_view word : SplitIntoWords(document)) {
+		if (!IsValidWord(word)) {
+			throw invalid_argument("Word "s + string(word.data(), word.size()) + " is invalid"s);
+		}
+		if (!IsStopWord(word)) {
+			tokenized.words.push_back(word);
+			tokenized.positions.push_back(position);
+		}
+		++position;
+	}
+}
+
+void SearchServer::AddDocuments(const vector<TokenizedDocument>& documents) {
+	for (const TokenizedDocument& document : documents) {
+		if ((document.id < 0) || (documents_.count(document.id) > 0)) {
+			throw invalid_argument("Invalid document_id"s);
+		}
+		AddDocumentWords(document.id, document.words, document.positions, document.status, document.ratings);
+	}
+}
+
+void SearchServer::AddDocumentWords(int document_id, const vector<string_view>& words, const vector<int>& positions,
+	DocumentStatus status, const vector<int>& ratings) {
+	const vector<int> term_ids = AddWords(words);
+
+	// Occurrences sorted by term id, then by position
+	vector<pair<int, int>> occurrences(term_ids.size());
+	for (size_t i = 0; i < term_ids.size(); ++i) {
+		occurrences[i] = { term_ids[i], positions[i] };
+	}
+	sort(occurrences.begin(), occurrences.end());
+	vector<pair<int, uint32_t>> term_counts;
+	for (const auto& [term_id, _] : occurrences) {
+		if (term_counts.empty() || term_counts.back().first != term_id) {
+			term_counts.push_back({ term_id, 0 });
+		}
+		++term_counts.back().second;
+	}
+	const int slot = static_cast<int>(slot_document_ids_.size());
+	forward_index_.Add(slot, term_counts);
+	if (options_.minhash_signature_size > 0) {
+		document_to_minhash_[document_id] = ComputeMinHashSignature(forward_index_.GetTermIds(slot), 
+																	options_.minhash_signature_size);
+	}
+
+	const double inv_word_count = 1.0 / term_ids.size();
+	auto occurrence_it = occurrences.begin();
+	vector<int> word_positions;
+	for (const auto& [term_id, term_count] : term_counts) {
+		const auto [postings_it, is_new_word] = word_to_document_freqs_.try_emplace(term_words_[term_id]);
+		if (is_new_word) {
+			dictionary_memory_usage_ += MAP_NODE_OVERHEAD + sizeof(*postings_it);
+		}
+		PostingList& postings = postings_it->second;
+		const size_t old_size = postings.size();
+		const size_t old_memory_usage = postings.GetMemoryUsage();
+		if (options_.store_word_positions) {
+			word_positions.clear();
+			for (uint32_t i = 0; i < term_count; ++i, ++occurrence_it) {
+				word_positions.push_back(occurrence_it->second);
+			}
+			postings.Add(slot, term_count * inv_word_count, word_positions);
+		}
+		else {
+			postings.Add(slot, term_count * inv_word_count);
+		}
+		UpdatePostingStatistics(postings, old_size, old_memory_usage);
+	}
+	document_lengths_.push_back(static_cast<int>(term_ids.size()));
+	total_document_length_ += term_ids.size();
+	const size_t length_bucket = GetDocumentLengthBucket(document_lengths_.back());
+	if (document_length_counts_.size() <= length_bucket) {
+		document_length_counts_.resize(length_bucket + 1);
+	}
+	++document_length_counts_[length_bucket];
+
+	const int rating = ComputeAverageRating(ratings);
+	documents_.emplace(document_id, DocumentData{ rating, status, slot });
+	document_ids_.insert(document_id);
+	slot_document_ids_.push_back(document_id);
+	document_filter_index_.Add(slot, status, rating);
+	++generation_;
+}
+
+SearchServer::PreparedQuery SearchServer::PrepareQuery(string_view raw_query, const QueryOptions& query_options) const {
+	return PrepareQuery(execution::seq, raw_query, query_options);
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
+	return FindTopDocuments(execution::seq, raw_query, status);
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, RatingRange rating_range) const {
+	return FindTopDocuments(execution::seq, raw_query, rating_range);
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status, RatingRange rating_range) const {
+	return FindTopDocuments(execution::seq, raw_query, status, rating_range);
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
+	return FindTopDocuments(execution::seq, raw_query);
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, const QueryOptions& query_options) const {
+	return FindTopDocuments(execution::seq, raw_query, query_options);
+}
+
+vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query, DocumentStatus status) const {
+	return FindTopDocuments(execution::seq, query, status);
+}
+
+vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query) const {
+	return FindTopDocuments(execution::seq, query);
+}
+
+int SearchServer::GetDocumentCount() const {
+	return documents_.size();
+}
+
+set<int>::const_iterator SearchServer::begin() const {
+	return document_ids_.begin();
+}
+
+set<int>::const_iterator SearchServer::end() const {
+	return document_ids_.end();
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const {
+	return MatchDocument(execution::seq, raw_query, document_id);
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const PreparedQuery& query, int document_id) const {
+	if (document_ids_.find(document_id) == document_ids_.end()) {
+		throw invalid_argument("Invalid document_id"s);
+	}
+	const DocumentData& document_data = documents_.at(document_id);
+	return { MatchQueryTerms(query.query_, query.terms_, document_data.slot), document_data.status };
+}
+
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocuments(string_view raw_query, 
+																			  const vector<int>& document_ids) const {
+	return MatchDocuments(execution::seq, raw_query, document_ids);
+}
+
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+	const int slot = FindSlot(document_id);
+	const TermIds term_ids = forward_index_.GetTermIds(slot);
+	if (term_ids.empty()) {
+		return {};
+	}
+	return { term_ids, forward_index_.GetTermCounts(slot), term_words_.data(), 1.0 / document_lengths_[slot] };
+}
+
+TermIds SearchServer::GetDocumentTermIds(int document_id) const {
+	return forward_index_.GetTermIds(FindSlot(document_id));
+}
+
+const vector<uint32_t>& SearchServer::GetMinHashSignature(int document_id) const {
+	const auto signature_it = document_to_minhash_.find(document_id);
+	if (signature_it == document_to_minhash_.end()) {
+		static const vector<uint32_t> empty_result;
+		return empty_result;
+	}
+	return signature_it->second;
+}
+
+const SearchServerOptions& SearchServer::GetOptions() const {
+	return options_;
+}
+
+IndexStatistics SearchServer::GetIndexStatistics() const {
+	IndexStatistics statistics;
+	statistics.document_count = GetDocumentCount();
+	statistics.term_count = term_count_;
+	statistics.posting_count = posting_count_;
+	statistics.total_document_length = total_document_length_;
+
+	IndexMemoryUsage& memory_usage = statistics.memory_usage;
+	memory_usage.dictionary = dictionary_memory_usage_ + term_words_.capacity() * sizeof(string_view);
+	memory_usage.postings = posting_memory_usage_;
+	memory_usage.forward_index = forward_index_.GetMemoryUsage();
+	memory_usage.metadata = documents_.size() * (MAP_NODE_OVERHEAD + sizeof(*documents_.begin()))
+		+ document_ids_.size() * (MAP_NODE_OVERHEAD + sizeof(int)) + slot_document_ids_.capacity() * sizeof(int)
+		+ document_filter_index_.GetMemoryUsage() + document_lengths_.capacity() * sizeof(int)
+		+ document_to_minhash_.size() * (MAP_NODE_OVERHEAD + sizeof(*document_to_minhash_.begin()) 
+										 + options_.minhash_signature_size * sizeof(uint32_t));
+
+	for (size_t bucket = 0; bucket < document_length_counts_.size(); ++bucket) {
+		const int min_length = bucket == 0 ? 0 : 1 << (bucket - 1);
+		const int max_length = bucket == 0 ? 0 : static_cast<int>((int64_t{ 1 } << bucket) - 1);
+		statistics.document_lengths.push_back({ min_length, max_length, document_length_counts_[bucket] });
+	}
+	while (!statistics.document_lengths.empty() && statistics.document_lengths.back().document_count == 0) {
+		statistics.document_lengths.pop_back();
+	}
+	return statistics;
+}
+
+vector<pair<string_view, size_t>> SearchServer::GetLongestPostingLists(size_t count) const {
+	vector<pair<string_view, size_t>> posting_counts;
+	posting_counts.reserve(term_count_);
+	for (const auto& [word, postings] : word_to_document_freqs_) {
+		if (!postings.empty()) {
+			posting_counts.push_back({ word, postings.size() });
+		}
+	}
+	count = min(count, posting_counts.size());
+	partial_sort(posting_counts.begin(), posting_counts.begin() + count, posting_counts.end(), 
+		[](const auto& lhs, const auto& rhs) {
+			return lhs.second > rhs.second || (lhs.second == rhs.second && lhs.first < rhs.first);
+		});
+	posting_counts.resize(count);
+	return posting_counts;
+}
+
+void SearchServer::RemoveDocument(int document_id) {
+	RemoveDocument(execution::seq, document_id);
+}
+
+void SearchServer::RemoveDocuments(const vector<int>& document_ids) {
+	RemoveDocuments(execution::seq, document_ids);
+}
+
+SearchServer::PostingRemovals SearchServer::GroupPostingRemovals(const vector<int>& sorted_document_ids) {
+	vector<int> sorted_slots;
+	sorted_slots.reserve(sorted_document_ids.size());
+	for (const int document_id : sorted_document_ids) {
+		sorted_slots.push_back(FindSlot(document_id));
+	}
+	sort(sorted_slots.begin(), sorted_slots.end());
+
+	// Counting sort by term id. Slots are visited in ascending order, so every term gets them sorted.
+	vector<size_t> term_offsets(term_words_.size() + 1, 0);
+	for (const int slot : sorted_slots) {
+		for (const int term_id : forward_index_.GetTermIds(slot)) {
+			++term_offsets[term_id + 1];
+		}
+	}
+
+	PostingRemovals removals;
+	removals.offsets.push_back(0);
+	for (size_t term_id = 0; term_id < term_words_.size(); ++term_id) {
+		if (term_offsets[term_id + 1] > 0) {
+			PostingList& postings = word_to_document_freqs_.find(term_words_[term_id])->second;
+			removals.postings.push_back(&postings);
+			removals.offsets.push_back(removals.offsets.back() + term_offsets[term_id + 1]);
+			removals.old_sizes.push_back(postings.size());
+			removals.old_memory_usages.push_back(postings.GetMemoryUsage());
+		}
+		term_offsets[term_id + 1] += term_offsets[term_id];
+	}
+
+	removals.slots.resize(term_offsets.back());
+	for (const int slot : sorted_slots) {
+		for (const int term_id : forward_index_.GetTermIds(slot)) {
+			removals.slots[term_offsets[term_id]++] = slot;
+		}
+	}
+	return removals;
+}
+
+void SearchServer::FinishRemovals(const PostingRemovals& removals, const vector<int>& sorted_document_ids) {
+	for (size_t i = 0; i < removals.postings.size(); ++i) {
+		UpdatePostingStatistics(*removals.postings[i], removals.old_sizes[i], removals.old_memory_usages[i]);
+	}
+	for (const int document_id : sorted_document_ids) {
+		EraseDocumentData(document_id);
+	}
+	if (removed_slot_count_ > documents_.size()) {
+		CompactSlots();
+	}
+	++generation_;
+}
+
+void SearchServer::PlaceOnNumaNodes(const NumaExecutor& executor) {
+	const size_t node_count = executor.GetNodeCount();
+	numa_boundaries_.assign(node_count + 1, 0);
+	numa_boundaries_.back() = numeric_limits<int>::max();
+	// Every node gets an equal share of the live documents, wherever the removed slots are
+	int slot = 0;
+	size_t document_index = 0;
+	for (size_t node = 1; node < node_count; ++node) {
+		const size_t first_index = documents_.size() * node / node_count;
+		for (; slot < static_cast<int>(slot_document_ids_.size()); ++slot) {
+			if (slot_document_ids_[slot] >= 0) {
+				if (document_index == first_index) {
+					break;
+				}
+				++document_index;
+			}
+		}
+		numa_boundaries_[node] = slot == static_cast<int>(slot_document_ids_.size()) ? numeric_limits<int>::max() : slot;
+	}
+
+	vector<PostingList*> long_postings;
+	for (auto& [_, postings] : word_to_document_freqs_) {
+		if (postings.size() >= NUMA_PLACEMENT_MIN_POSTINGS) {
+			long_postings.push_back(&postings);
+		}
+	}
+	// Allocated here without being written, every node then writes its own part first
+	vector<PostingList> placed_postings(long_postings.size());
+	for (size_t i = 0; i < long_postings.size(); ++i) {
+		placed_postings[i].slots.resize(long_postings[i]->size());
+		placed_postings[i].term_freqs.resize(long_postings[i]->size());
+	}
+	executor.Run([&](size_t node, size_t worker) {
+		const size_t worker_count = executor.GetWorkerCount(node);
+		for (size_t i = 0; i < long_postings.size(); ++i) {
+			const PostingList& postings = *long_postings[i];
+			const auto [node_first, node_last] = postings.FindRange(numa_boundaries_[node], numa_boundaries_[node + 1]);
+			const size_t first = node_first + (node_last - node_first) * worker / worker_count;
+			const size_t last = node_first + (node_last - node_first) * (worker + 1) / worker_count;
+			copy(postings.slots.begin() + first, postings.slots.begin() + last, 
+				 placed_postings[i].slots.begin() + first);
+			copy(postings.term_freqs.begin() + first, postings.term_freqs.begin() + last, 
+				 placed_postings[i].term_freqs.begin() + first);
+		}
+		});
+	for (size_t i = 0; i < long_postings.size(); ++i) {
+		const size_t old_memory_usage = long_postings[i]->GetMemoryUsage();
+		long_postings[i]->slots.swap(placed_postings[i].slots);
+		long_postings[i]->term_freqs.swap(placed_postings[i].term_freqs);
+		UpdatePostingStatistics(*long_postings[i], long_postings[i]->size(), old_memory_usage);
+	}
+}
+
+void SearchServer::UpdatePostingStatistics(const PostingList& postings, size_t old_size, size_t old_memory_usage) {
+	posting_count_ = posting_count_ + postings.size() - old_size;
+	posting_memory_usage_ = posting_memory_usage_ + postings.GetMemoryUsage() - old_memory_usage;
+	term_count_ = term_count_ + !postings.empty() - (old_size > 0);
+}
+
+size_t SearchServer::GetDocumentLengthBucket(int length) {
+	size_t bucket = 0;
+	for (; length > 0; length >>= 1) {
+		++bucket;
+	}
+	return bucket;
+}
+
+void SearchServer::EraseDocumentData(int document_id) {
+	const DocumentData& document_data = documents_.at(document_id);
+	document_filter_index_.Remove(document_data.slot, document_data.status);
+	total_document_length_ -= document_lengths_[document_data.slot];
+	--document_length_counts_[GetDocumentLengthBucket(document_lengths_[document_data.slot])];
+	forward_index_.Remove(document_data.slot);
+	slot_document_ids_[document_data.slot] = -1;
+	++removed_slot_count_;
+	document_to_minhash_.erase(document_id);
+	documents_.erase(document_id);
+	document_ids_.erase(document_id);
+}
+
+bool SearchServer::IsStopWord(std::string_view word) const {
+	return stop_words_.count(word) > 0;
+}
+
+int SearchServer::FindTermId(string_view word) const {
+	const auto word_it = words_.find(word);
+	return word_it == words_.end() ? -1 : word_it->second;
+}
+
+bool SearchServer::IsValidWord(std::string_view word) {
+	// A valid word must not contain special characters
+	return none_of(word.begin(), word.end(), [](char c) {
+		return c >= '\0' && c < ' ';
+		});
+}
+
+vector<int> SearchServer::GetNumaBoundaries(size_t node_count) const {
+	if (numa_boundaries_.size() == node_count + 1) {
+		return numa_boundaries_;
+	}
+	const int64_t slot_count = static_cast<int64_t>(slot_document_ids_.size());
+	vector<int> boundaries(node_count + 1);
+	for (size_t node = 0; node < node_count; ++node) {
+		boundaries[node] = static_cast<int>(slot_count * node / node_count);
+	}
+	boundaries.back() = numeric_limits<int>::max();
+	return boundaries;
+}
+
+vector<int> SearchServer::AddWords(const vector<string_view>& words) {
+	vector<int> term_ids;
+	term_ids.reserve(words.size());
+	for (const string_view word : words) {
+		const auto [word_it, is_new] = words_.emplace(string(word), static_cast<int>(words_.size()));
+		if (is_new) {
+			term_words_.push_back(word_it->first);
+			dictionary_memory_usage_ += MAP_NODE_OVERHEAD + sizeof(*word_it) + GetHeapMemoryUsage(word_it->first);
+		}
+		term_ids.push_back(word_it->second);
+	}
+	return term_ids;
+}
+
+int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
+	if (ratings.empty()) {
+		return 0;
+	}
+	int rating_sum = 0;
+	for (const int rating : ratings) {
+		rating_sum += rating;
+	}
+	return rating_sum / static_cast<int>(ratings.size());
+}
+
+bool SearchServer::IsRankedHigher(const Document& lhs, const Document& rhs) {
+	if (abs(lhs.relevance - rhs.relevance) >= 1e-6) {
+		return lhs.relevance > rhs.relevance;
+	}
+	if (lhs.rating != rhs.rating) {
+		return lhs.rating > rhs.rating;
+	}
+	return lhs.id < rhs.id;
+}
+
+SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
+	if (text.empty()) {
+		throw invalid_argument("Query word is empty"s);
+	}
+
+	bool is_minus = false;
+	if (text[0] == '-') {
+		is_minus = true;
+		text = text.substr(1, text.size() - 1);
+	}
+	if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
+		throw invalid_argument("Query word "s + string(text.data(), text.size()) + " is invalid");
+	}
+
+	if (options_.max_prefix_expansions > 0 && text.size() > 1 && text.back() == '*') {
+		return { text.substr(0, text.size() - 1), is_minus, false, true };
+	}
+	return { text, is_minus, IsStopWord(text), false };
+}
+
+void SearchServer::AddFuzzyWords(string_view word, const QueryOptions& query_options, Query& query) const {
+	if (query_options.max_edit_distance < 0 || query_options.max_edit_distance > 2) {
+		throw invalid_argument("Edit distance must be from 0 to 2"s);
+	}
+	const int max_distance = min(query_options.max_edit_distance, static_cast<int>(word.size() - 1) / 2);
+	if (max_distance == 0) {
+		return;
+	}
+
+	auto matches = FindFuzzyMatches(word_to_document_freqs_, LevenshteinAutomaton(word, max_distance));
+	matches.erase(remove_if(matches.begin(), matches.end(), [this, &query](const auto& match) {
+		return query.plus_words.count(match.first) > 0 || word_to_document_freqs_.at(match.first).empty();
+		}), matches.end());
+
+	const size_t match_count = min(matches.size(), query_options.max_fuzzy_expansions);
+	partial_sort(matches.begin(), matches.begin() + match_count, matches.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.second < rhs.second;
+		});
+	for (size_t i = 0; i < match_count; ++i) {
+		const auto [match, distance] = matches[i];
+		const double weight = pow(query_options.fuzzy_weight, distance);
+		double& query_weight = query.fuzzy_words[match];
+		query_weight = max(query_weight, weight);
+		query.word_clauses[match] |= query.word_clauses.at(word);
+	}
+}
+
+vector<string_view> SearchServer::ExpandPrefix(string_view prefix) const {
+	// word_to_document_freqs_ is ordered, so the words with the prefix form one run
+	vector<pair<size_t, string_view>> expansions;
+	for (auto it = word_to_document_freqs_.lower_bound(prefix); 
+		 it != word_to_document_freqs_.end() && it->first.substr(0, prefix.size()) == prefix; ++it) {
+		if (!it->second.empty()) {
+			expansions.push_back({ it->second.size(), it->first });
+		}
+	}
+
+	const size_t expansion_count = min(expansions.size(), options_.max_prefix_expansions);
+	partial_sort(expansions.begin(), expansions.begin() + expansion_count, expansions.end(), 
+		[](const auto& lhs, const auto& rhs) {
+			return lhs.first > rhs.first;
+		});
+
+	vector<string_view> words(expansion_count);
+	transform(expansions.begin(), expansions.begin() + expansion_count, words.begin(), [](const auto& expansion) {
+		return expansion.second;
+		});
+	return words;
+}
+
+SearchServer::QueryTerms SearchServer::ResolveQueryTerms(const Query& query) const {
+	QueryTerms query_terms;
+	for (string_view word : query.minus_words) {
+		const int term_id = FindTermId(word);
+		if (term_id >= 0) {
+			query_terms.minus_term_ids.push_back(term_id);
+		}
+	}
+	const auto add_plus_word = [this, &query_terms](string_view word) {
+		const auto word_it = words_.find(word);
+		if (word_it != words_.end()) {
+			query_terms.plus_terms.push_back({ word_it->second, word_it->first });
+		}
+	};
+	for (string_view word : query.plus_words) {
+		add_plus_word(word);
+	}
+	for (const auto& [word, _] : query.fuzzy_words) {
+		add_plus_word(word);
+	}
+	sort(query_terms.plus_terms.begin(), query_terms.plus_terms.end());
+	return query_terms;
+}
+
+vector<string_view> SearchServer::MatchQueryTerms(const Query& query, const QueryTerms& query_terms, int slot) const {
+	if (!MatchesPositionalConstraints(query, slot)) {
+		return {};
+	}
+
+	const TermIds document_term_ids = forward_index_.GetTermIds(slot);
+	for (const int term_id : query_terms.minus_term_ids) {
+		if (binary_search(document_term_ids.begin(), document_term_ids.end(), term_id)) {
+			return {};
+		}
+	}
+
+	// Both lists are sorted by term id, so the search for every next query term
+	// continues from where the previous one stopped
+	vector<string_view> matched_words;
+	auto document_term_it = document_term_ids.begin();
+	for (const auto& [term_id, word] : query_terms.plus_terms) {
+		document_term_it = GallopLowerBound(document_term_it, document_term_ids.end(), term_id);
+		if (document_term_it == document_term_ids.end()) {
+			break;
+		}
+		if (*document_term_it == term_id) {
+			matched_words.push_back(word);
+		}
+	}
+	sort(matched_words.begin(), matched_words.end());
+	return matched_words;
+}
+
+SearchServer::QueryPostings SearchServer::FetchQueryPostings(const Query& query) const {
+	switch (options_.ranking_model) {
+	case RankingModel::BM25:
+		return FetchQueryPostings(query, MakeBm25Ranking());
+	default:
+		return FetchQueryPostings(query, TfIdfRanking{});
+	}
+}
+
+void SearchServer::CheckDocumentIds(const vector<int>& document_ids) const {
+	if (!all_of(document_ids.begin(), document_ids.end(), [this](int document_id) { return document_ids_.count(document_id) > 0; })) {
+		throw invalid_argument("Invalid document_id"s);
+	}
+}
+
+int SearchServer::FindSlot(int document_id) const {
+	const auto document_it = documents_.find(document_id);
+	return document_it == documents_.end() ? -1 : document_it->second.slot;
+}
+
+void SearchServer::CompactSlots() {
+	// Live documents keep their order, so whatever is sorted by slot stays sorted
+	vector<int> new_slots(slot_document_ids_.size(), -1);
+	int slot_count = 0;
+	for (size_t slot = 0; slot < slot_document_ids_.size(); ++slot) {
+		const int document_id = slot_document_ids_[slot];
+		if (document_id >= 0) {
+			new_slots[slot] = slot_count;
+			slot_document_ids_[slot_count] = document_id;
+			document_lengths_[slot_count] = document_lengths_[slot];
+			documents_.at(document_id).slot = slot_count;
+			++slot_count;
+		}
+	}
+	slot_document_ids_.resize(slot_count);
+	slot_document_ids_.shrink_to_fit();
+	document_lengths_.resize(slot_count);
+	document_lengths_.shrink_to_fit();
+	removed_slot_count_ = 0;
+
+	forward_index_.RemapSlots(new_slots);
+	document_filter_index_.RemapSlots(new_slots);
+	for (auto& [_, postings] : word_to_document_freqs_) {
+		postings.RemapSlots(new_slots);
+	}
+	// A boundary moves to the first live slot at or after it
+	for (int& boundary : numa_boundaries_) {
+		if (boundary == numeric_limits<int>::max()) {
+			continue;
+		}
+		int first_live_slot = boundary;
+		while (first_live_slot < static_cast<int>(new_slots.size()) && new_slots[first_live_slot] < 0) {
+			++first_live_slot;
+		}
+		boundary = first_live_slot < static_cast<int>(new_slots.size()) ? new_slots[first_live_slot] : slot_count;
+	}
+}
+
+Document SearchServer::MakeDocument(int slot, double relevance) const {
+	return { slot_document_ids_[slot], relevance, document_filter_index_.GetRating(slot) };
+}
+
+Bm25Ranking SearchServer::MakeBm25Ranking() const {
+	const double average_document_length = documents_.empty() || total_document_length_ == 0 
+		? 1.0 
+		: static_cast<double>(total_document_length_) / documents_.size();
+	return { { options_.bm25_k1, options_.bm25_b, average_document_length }, document_lengths_.data() };
+}
+
+vector<string_view> SearchServer::ParsePositionalOperators(const vector<string_view>& words, Query& query) const {
+	vector<string_view> plain_words;
+	bool previous_is_plain_word = false;
+
+	for (size_t i = 0; i < words.size(); ++i) {
+		string_view token = words[i];
+
+		int max_distance = 0;
+		if (ParseNearOperator(token, max_distance)) {
+			if (!previous_is_plain_word || i + 1 == words.size() || words[i + 1][0] == '-' || words[i + 1][0] == '"') {
+				throw invalid_argument("Operator "s + string(token) + " needs a word on both sides"s);
+			}
+			const string_view first_word = plain_words.back();
+			const string_view second_word = words[++i];
+			plain_words.push_back(second_word);
+			if (!IsStopWord(first_word) && !IsStopWord(second_word)) {
+				query.proximities.push_back({ first_word, second_word, max_distance });
+			}
+			continue;
+		}
+
+		const bool is_minus = token.size() > 1 && token[0] == '-' && token[1] == '"';
+		if (is_minus) {
+			token.remove_prefix(1);
+		}
+		if (token[0] != '"') {
+			plain_words.push_back(token);
+			previous_is_plain_word = token[0] != '-';
+			continue;
+		}
+
+		token.remove_prefix(1);
+		Phrase phrase{ {}, is_minus };
+		int offset = 0;
+		for (bool closed = false; !closed;) {
+			if (!token.empty() && token.back() == '"') {
+				token.remove_suffix(1);
+				closed = true;
+			}
+			if (!token.empty()) {
+				const QueryWord query_word = ParseQueryWord(token);
+				if (query_word.is_minus || query_word.is_prefix) {
+					throw invalid_argument("Phrase word "s + string(token) + " is invalid"s);
+				}
+				if (!query_word.is_stop) {
+					phrase.words.push_back({ query_word.data, offset });
+				}
+				if (!is_minus) {
+					plain_words.push_back(query_word.data);
+				}
+				// Stop words are not indexed but still take a position
+				++offset;
+			}
+			if (!closed) {
+				if (++i == words.size()) {
+					throw invalid_argument("Phrase is not closed"s);
+				}
+				token = words[i];
+			}
+		}
+		if (!phrase.words.empty()) {
+			query.phrases.push_back(move(phrase));
+		}
+		previous_is_plain_word = false;
+	}
+	return plain_words;
+}
+
+bool SearchServer::MatchesPositionalConstraints(const Query& query, int slot) const {
+	for (const Phrase& phrase : query.phrases) {
+		if (ContainsPhrase(phrase, slot) == phrase.is_minus) {
+			return false;
+		}
+	}
+	for (const Proximity& proximity : query.proximities) {
+		if (!AreWithinDistance(GetWordPositions(proximity.first_word, slot), 
+							   GetWordPositions(proximity.second_word, slot), proximity.max_distance)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SearchServer::ContainsPhrase(const Phrase& phrase, int slot) const {
+	// Every word gives the positions where the phrase could start, the phrase occurs
+	// where all of them agree
+	vector<vector<int>> phrase_starts;
+	for (const auto& [word, offset] : phrase.words) {
+		vector<int> positions = GetWordPositions(word, slot);
+		if (positions.empty()) {
+			return false;
+		}
+		for (int& position : positions) {
+			position -= offset;
+		}
+		phrase_starts.push_back(move(positions));
+	}
+
+	// Intersecting from the shortest list keeps every intermediate result small
+	sort(phrase_starts.begin(), phrase_starts.end(), [](const vector<int>& lhs, const vector<int>& rhs) {
+		return lhs.size() < rhs.size();
+		});
+	vector<int> candidates = move(phrase_starts[0]);
+	for (size_t i = 1; i < phrase_starts.size() && !candidates.empty(); ++i) {
+		vector<int> matched;
+		set_intersection(candidates.begin(), candidates.end(), phrase_starts[i].begin(), phrase_starts[i].end(), 
+						 back_inserter(matched));
+		candidates = move(matched);
+	}
+	return !candidates.empty();
+}
+
+vector<int> SearchServer::GetWordPositions(string_view word, int slot) const {
+	const auto postings_it = word_to_document_freqs_.find(word);
+	if (postings_it == word_to_document_freqs_.end()) {
+		return {};
+	}
+	const PostingList& postings = postings_it->second;
+	const size_t index = postings.Find(slot);
+	return index == postings.size() ? vector<int>{} : postings.GetPositions(index);
 }
\ No newline at end of file
@@ -1,294 +1,1158 @@
-#pragma once
-
-#include "document.h"
-#include "string_processing.h"
-#include "log_duration.h"
-#include "concurrent_map.h"
-
-#include <map>
-#include <set>
-#include <string>
-#include <vector>
-#include <algorithm>
-#include <execution>
-
-
-const int MAX_RESULT_DOCUMENT_COUNT = 5;
-
-class SearchServer {
-public:
-	template <typename StringContainer>
-	explicit SearchServer(const StringContainer& stop_words);
-
-	explicit SearchServer(std::string_view stop_words_text);
-	explicit SearchServer(const std::string& stop_words_text);
-
-	void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
-
-	template <typename DocumentPredicate, typename Policy>
-	std::vector<Document> FindTopDocuments(Policy policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
-
-	template <typename DocumentPredicate>
-	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
-	
-	template <typename Policy>
-	std::vector<Document> FindTopDocuments(Policy policy, std::string_view raw_query, DocumentStatus status) const;
-	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
-
-	template <typename Policy>
-	std::vector<Document> FindTopDocuments(Policy policy, std::string_view raw_query) const;
-	std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
-
-	int GetDocumentCount() const;
-
-	std::set<int>::const_iterator begin() const;
-	std::set<int>::const_iterator end() const;
-
-	template <typename Policy>
-	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(Policy policy, std::string_view raw_query, int document_id) const;
-	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
-
-	const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
-
-	template <typename Policy>
-	void RemoveDocument(Policy policy, int document_id);
-	void RemoveDocument(int document_id);
-
-private:
-	struct DocumentData {
-		int rating;
-		DocumentStatus status;
-	};
-	const std::set<std::string, std::less<>> stop_words_;
-
-	std::set<std::string> words_;
-	std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-	std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-	
-	std::map<int, DocumentData> documents_;
-	std::set<int> document_ids_;
-
-	bool IsStopWord(std::string_view word) const;
-
-	static bool IsValidWord(std::string_view word);
-
-	std::vector<std::string_view> SplitIntoWordsNoStopAndAddWords(std::string_view text);
-
-	static int ComputeAverageRating(const std::vector<int>& ratings);
-
-	struct QueryWord {
-		std::string_view data;
-		bool is_minus;
-		bool is_stop;
-	};
-
-	QueryWord ParseQueryWord(std::string_view text) const;
-
-	struct Query {
-		std::set<std::string_view> plus_words;
-		std::set<std::string_view> minus_words;
-	};
-
-	template<typename Policy>
-	SearchServer::Query ParseQuery(Policy policy, std::string_view text) const;
-
-	double ComputeWordInverseDocumentFreq(std::string_view word) const;
-
-	template <typename DocumentPredicate, typename Policy>
-	std::vector<Document> FindAllDocuments(ConcurrentMap<int, double>& document_to_relevance, Policy policy,
-											const SearchServer::Query& query, 
-											DocumentPredicate document_predicate) const;
-
-	template <typename DocumentPredicate>
-	std::vector<Document> FindAllDocuments(std::execution::sequenced_policy policy, const Query& query, DocumentPredicate document_predicate) const;
-
-	template <typename DocumentPredicate>
-	std::vector<Document> FindAllDocuments(std::execution::parallel_policy policy, const Query& query, DocumentPredicate document_predicate) const;
-};
-
-template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
-	: stop_words_(MakeUniqueNonEmptyStrings(stop_words))  // Extract non-empty stop words
-{
-	if (!std::all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
-		using namespace std::literals::string_literals;
-		throw std::invalid_argument("Some of stop words are invalid"s);
-	}
-}
-
-template <typename DocumentPredicate, typename Policy>
-std::vector<Document> SearchServer::FindTopDocuments(Policy policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-	const auto query = ParseQuery(policy, raw_query);
-
-	auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-
-	sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-		if (std::abs(lhs.relevance - rhs.relevance) < 1e-6) {
-			return lhs.rating > rhs.rating;
-		}
-		else {
-			return lhs.relevance > rhs.relevance;
-		}
-		});
-	if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-		matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-	}
-
-	return matched_documents;
-}
-
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
-	return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
-}
-
-template <typename Policy>
-std::vector<Document> SearchServer::FindTopDocuments(Policy policy, std::string_view raw_query, DocumentStatus status) const {
-	return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-		return document_status == status;
-		}
-	);
-}
-
-template <typename Policy>
-std::vector<Document> SearchServer::FindTopDocuments(Policy policy, std::string_view raw_query) const {
-	return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
-}
-
-template <typename Policy>
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(Policy policy, std::string_view raw_query, 
-																					  int document_id) const {
-	if (document_ids_.find(document_id) == document_ids_.end()) {
-		using namespace std::literals::string_literals;
-		throw std::invalid_argument("Invalid document_id"s);
-	}
-
-	const auto query = ParseQuery(policy, raw_query);
-
-	std::atomic_int count = 0;
-	std::atomic_bool no_minus_word = true;
-
-	std::vector<std::pair<std::string_view, double>> matched_words_freqs(query.plus_words.size());
-
-	copy_if(policy, document_to_word_freqs_.at(document_id).begin(), document_to_word_freqs_.at(document_id).end(), 
-			matched_words_freqs.begin(), [&query, &no_minus_word, &count](std::pair<std::string_view, double> word_freqs) {
-				if (no_minus_word) {
-					no_minus_word = !query.minus_words.count(word_freqs.first) && no_minus_word;
-					return query.plus_words.count(word_freqs.first) ? static_cast<bool>(++count) : false;
-				} 
-				else {
-					return false;
-				}				
-			}
-	);
-	if (!no_minus_word) {
-		count = 0;
-	}
-		
-	matched_words_freqs.resize(count);
-	std::vector<std::string_view> matched_words(count);
-
-	transform(policy, matched_words_freqs.begin(), matched_words_freqs.end(), matched_words.begin(), 
-				[](std::pair<std::string_view, double> word_freqs) { 
-					return word_freqs.first;
-				}
-	);
-
-	return { matched_words, documents_.at(document_id).status };
-}
-
-template <typename Policy>
-void SearchServer::RemoveDocument(Policy policy, int document_id) {
-	auto document_ids_it = document_ids_.find(document_id);
-
-	if (document_ids_it == document_ids_.end()) {
-		using namespace std::literals::string_literals;
-		throw std::invalid_argument("Invalid document_id"s);
-	}
-
-	auto document_words = move(document_to_word_freqs_[document_id]);
-	for_each(policy, document_words.begin(), document_words.end(), 
-			[this, document_id](const auto& word) {
-				word_to_document_freqs_[word.first].erase(document_id); 
-			}
-	);
-
-	document_to_word_freqs_.erase(document_id);
-	documents_.erase(document_id);
-	document_ids_.erase(document_ids_it);
-}
-
-template<typename Policy>
-SearchServer::Query SearchServer::ParseQuery(Policy policy, std::string_view text) const {
-
-	auto words = SplitIntoWords(text);
-	std::vector<QueryWord> query_words(words.size());
-	std::transform(policy, words.begin(), words.end(), query_words.begin(), [this](std::string_view word) {return ParseQueryWord(word); });
-
-	Query result;
-
-	for (QueryWord& query_word : query_words) {
-		if (!query_word.is_stop) {
-			if (query_word.is_minus) {
-				result.minus_words.insert(query_word.data);
-			}
-			else {
-				result.plus_words.insert(query_word.data);
-			}
-		}
-	}
-	return result;
-}
-
-template <typename DocumentPredicate, typename Policy>
-std::vector<Document> SearchServer::FindAllDocuments(ConcurrentMap<int, double>& document_to_relevance, Policy policy,
-	const SearchServer::Query& query,
-	DocumentPredicate document_predicate) const {
-
-	std::for_each(policy,
-		query.plus_words.begin(),
-		query.plus_words.end(),
-		[this, &document_predicate, &document_to_relevance](std::string_view word) {
-			if (word_to_document_freqs_.find(word) != word_to_document_freqs_.end()) {
-				const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-				for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-					const auto& document_data = documents_.at(document_id);
-					if (document_predicate(document_id, document_data.status, document_data.rating)) {
-						document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-					}
-				}
-			}
-		}
-	);
-
-	for (std::string_view word : query.minus_words) {
-		if (word_to_document_freqs_.find(word) == word_to_document_freqs_.end()) {
-			continue;
-		}
-		for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-			document_to_relevance.erase(document_id);
-		}
-	}
-
-	std::vector<Document> matched_documents;
-	for (auto& [document_id, relevance] : document_to_relevance) {
-		matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
-	}
-	return matched_documents;
-}
-
-
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy policy, const SearchServer::Query& query, DocumentPredicate document_predicate) const {
-
-
-	ConcurrentMap<int, double> document_to_relevance(1);
-	return FindAllDocuments(document_to_relevance, policy, query, document_predicate);
-}
-
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy policy, const SearchServer::Query& query, DocumentPredicate document_predicate) const {
-
-	ConcurrentMap<int, double> document_to_relevance(240);
-	return FindAllDocuments(document_to_relevance, policy, query, document_predicate);
+#pragma once
+
+#include "document.h"
+#include "document_filter.h"
+#include "string_processing.h"
+#include "log_duration.h"
+#include "concurrent_map.h"
+#include "posting_list.h"
+#include "forward_index.h"
+#include "ranking.h"
+#include "scoring.h"
+#include "levenshtein_automaton.h"
+#include "intersection.h"
+#include "minhash.h"
+#include "numa_executor.h"
+#include "index_statistics.h"
+
+#include <bitset>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <execution>
+#include <iterator>
+#include <numeric>
+#include <type_traits>
+
+
+const int MAX_RESULT_DOCUMENT_COUNT = 5;
+
+// QueryOptions::minimum_should_match requiring every plus word of the query
+const size_t ALL_QUERY_WORDS = std::numeric_limits<size_t>::max();
+// Plus words a query with minimum_should_match above 1 may have
+const size_t MAX_CONJUNCTIVE_QUERY_WORDS = 64;
+
+// Queries touching at least one posting per this many document slots are scored
+// in a dense buffer, sparser ones in a ConcurrentMap
+const int DENSE_SCORING_MAX_SPARSITY = 64;
+// Number of slot ranges scored independently by a parallel dense query
+const int DENSE_SCORING_CHUNK_COUNT = 16;
+// Shorter queries are parsed sequentially even under a parallel policy
+const size_t PARALLEL_QUERY_PARSING_MIN_WORDS = 64;
+// Shorter posting lists would be copied into heap pages that are already touched, and
+// so already placed. From this length on every buffer of a list gets pages of its own.
+const size_t NUMA_PLACEMENT_MIN_POSTINGS = HUGE_PAGE_MIN_BUFFER_SIZE / sizeof(int);
+
+struct SearchServerOptions {
+	RankingModel ranking_model = RankingModel::TF_IDF;
+	// BM25 term frequency saturation and document length normalization
+	double bm25_k1 = 1.2;
+	double bm25_b = 0.75;
+	// Keeps word positions in the postings and enables "phrase" and NEAR/k queries
+	bool store_word_positions = false;
+	// A query word ending with * matches up to this many indexed words starting with
+	// the rest of it, the ones found in most documents first. 0 disables prefix queries.
+	size_t max_prefix_expansions = 64;
+	// Rows of the MinHash signature computed for every added document, used by
+	// FindNearDuplicates. 0 keeps no signatures.
+	size_t minhash_signature_size = 0;
+};
+
+// Position of a result in the ranking: results come by descending relevance, then
+// descending rating, then ascending id. Pass the last result of a page to get the next one.
+struct SearchCursor {
+	double relevance = 0.0;
+	int rating = 0;
+	int document_id = 0;
+};
+
+SearchCursor MakeSearchCursor(const Document& document);
+
+// Opaque text form of a cursor, for handing it out to clients
+std::string EncodeSearchCursor(const SearchCursor& cursor);
+SearchCursor DecodeSearchCursor(std::string_view text);
+
+// Settings of a single FindTopDocuments call
+struct QueryOptions {
+	// Typo tolerance: plus words also match indexed words within this many edits (0 to 2).
+	// Words of up to two letters are still matched exactly, of up to four letters with one edit.
+	int max_edit_distance = 0;
+	// A match at edit distance d counts as fuzzy_weight^d of an exact match
+	double fuzzy_weight = 0.5;
+	// Fuzzy matches kept per plus word, closest first
+	size_t max_fuzzy_expansions = 16;
+	// Fills Document::matched_words of the results, as MatchDocument would
+	bool with_matched_words = false;
+	// Results contain at least this many of the distinct plus words of the query, a word
+	// also counts through its prefix and fuzzy expansions. 1 finds documents with any of
+	// them, ALL_QUERY_WORDS only documents with all of them.
+	size_t minimum_should_match = 1;
+	// Only results ranked after this cursor are returned
+	std::optional<SearchCursor> search_after;
+	// Results skipped from the top (after search_after, if given) and returned at most.
+	// Only the top offset + limit results are ever sorted.
+	size_t offset = 0;
+	size_t limit = MAX_RESULT_DOCUMENT_COUNT;
+};
+
+// A document split into words by SearchServer::TokenizeDocument, for adding with
+// AddDocuments. words view a text that must outlive the AddDocuments call.
+struct TokenizedDocument {
+	int id = 0;
+	DocumentStatus status = DocumentStatus::ACTUAL;
+	std::vector<int> ratings;
+	// Non-stop words of the text and their positions among all its words
+	std::vector<std::string_view> words;
+	std::vector<int> positions;
+};
+
+class SearchServer {
+public:
+	template <typename StringContainer>
+	explicit SearchServer(const StringContainer& stop_words, const SearchServerOptions& options = {});
+
+	explicit SearchServer(std::string_view stop_words_text, const SearchServerOptions& options = {});
+	explicit SearchServer(const std::string& stop_words_text, const SearchServerOptions& options = {});
+
+	void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+	// Splits and checks a document text the way AddDocument does. Reads nothing but the
+	// stop words, so documents may be tokenized on other threads while others are added.
+	void TokenizeDocument(std::string_view document, TokenizedDocument& tokenized) const;
+
+	// Adds tokenized documents in order, only indexing their words. The documents
+	// before one with an invalid id stay added.
+	void AddDocuments(const std::vector<TokenizedDocument>& documents);
+
+	class PreparedQuery;
+
+	// Parses the query and resolves it against the index once, for running it many times
+	template <typename Policy>
+	PreparedQuery PrepareQuery(Policy policy, std::string_view raw_query, const QueryOptions& query_options = {}) const;
+	PreparedQuery PrepareQuery(std::string_view raw_query, const QueryOptions& query_options = {}) const;
+
+	template <typename DocumentPredicate, typename Policy>
+	std::vector<Document> FindTopDocuments(Policy policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+
+	template <typename DocumentPredicate>
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+	
+	template <typename Policy>
+	std::vector<Document> FindTopDocuments(Policy policy, std::string_view raw_query, DocumentStatus status) const;
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+
+	template <typename Policy>
+	std::vector<Document> FindTopDocuments(Policy policy, std::string_view raw_query, RatingRange rating_range) const;
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, RatingRange rating_range) const;
+
+	template <typename Policy>
+	std::vector<Document> FindTopDocuments(Policy policy, std::string_view raw_query, DocumentStatus status, RatingRange rating_range) const;
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status, RatingRange rating_range) const;
+
+	template <typename Policy>
+	std::vector<Document> FindTopDocuments(Policy policy, std::string_view raw_query) const;
+	std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+	template <typename DocumentPredicate, typename Policy>
+	std::vector<Document> FindTopDocuments(Policy policy, std::string_view raw_query, const QueryOptions& query_options, 
+										   DocumentPredicate document_predicate) const;
+
+	template <typename Policy>
+	std::vector<Document> FindTopDocuments(Policy policy, std::string_view raw_query, const QueryOptions& query_options, 
+										   DocumentStatus status) const;
+
+	template <typename Policy>
+	std::vector<Document> FindTopDocuments(Policy policy, std::string_view raw_query, const QueryOptions& query_options) const;
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, const QueryOptions& query_options) const;
+
+	template <typename DocumentPredicate, typename Policy>
+	std::vector<Document> FindTopDocuments(Policy policy, const PreparedQuery& query, DocumentPredicate document_predicate) const;
+
+	template <typename Policy>
+	std::vector<Document> FindTopDocuments(Policy policy, const PreparedQuery& query, DocumentStatus status) const;
+	std::vector<Document> FindTopDocuments(const PreparedQuery& query, DocumentStatus status) const;
+
+	template <typename Policy>
+	std::vector<Document> FindTopDocuments(Policy policy, const PreparedQuery& query) const;
+	std::vector<Document> FindTopDocuments(const PreparedQuery& query) const;
+
+	int GetDocumentCount() const;
+
+	std::set<int>::const_iterator begin() const;
+	std::set<int>::const_iterator end() const;
+
+	template <typename Policy>
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(Policy policy, std::string_view raw_query, int document_id) const;
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const PreparedQuery& query, int document_id) const;
+
+	// MatchDocument for every id, with the query parsed only once
+	template <typename Policy>
+	std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(Policy policy, std::string_view raw_query, 
+																						   const std::vector<int>& document_ids) const;
+	std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(std::string_view raw_query, 
+																						   const std::vector<int>& document_ids) const;
+	template <typename Policy>
+	std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(Policy policy, const PreparedQuery& query, 
+																						   const std::vector<int>& document_ids) const;
+
+	// Views into the index, valid until the next AddDocument or RemoveDocument. Empty for unknown ids.
+	WordFrequencies GetWordFrequencies(int document_id) const;
+	// Sorted term ids of the distinct words of the document
+	TermIds GetDocumentTermIds(int document_id) const;
+	// Empty for unknown ids and for servers without minhash_signature_size
+	const std::vector<uint32_t>& GetMinHashSignature(int document_id) const;
+	const SearchServerOptions& GetOptions() const;
+
+	// Counters kept up to date by every change of the index, read in constant time
+	IndexStatistics GetIndexStatistics() const;
+	// The count words found in most documents with their posting counts, most first.
+	// Scans the whole dictionary.
+	std::vector<std::pair<std::string_view, size_t>> GetLongestPostingLists(size_t count) const;
+
+	template <typename Policy>
+	void RemoveDocument(Policy policy, int document_id);
+	void RemoveDocument(int document_id);
+	// Removes all the documents at once, every posting list is compacted only once.
+	// A parallel policy compacts different posting lists in parallel.
+	template <typename Policy>
+	void RemoveDocuments(Policy policy, const std::vector<int>& document_ids);
+	void RemoveDocuments(const std::vector<int>& document_ids);
+
+	// Splits the document slots into one range per node of the executor, with equal
+	// numbers of documents, and moves the long posting lists so that the postings of
+	// every range sit in the memory of its node. Queries run with NumaPolicy then
+	// score every range on its own node. Postings added later are allocated by the
+	// adding thread, so call it again after large batches of AddDocument.
+	void PlaceOnNumaNodes(const NumaExecutor& executor);
+
+private:
+	struct DocumentData {
+		int rating;
+		DocumentStatus status;
+		// Position of the document in the per-document arrays of the index
+		int slot;
+	};
+	const std::set<std::string, std::less<>> stop_words_;
+	const SearchServerOptions options_;
+
+	// Every indexed word with its term id, ids are given out in order of first appearance
+	std::map<std::string, int, std::less<>> words_;
+	// The keys of words_ indexed by term id
+	std::vector<std::string_view> term_words_;
+	std::map<std::string_view, PostingList> word_to_document_freqs_;
+	ForwardIndex forward_index_;
+	std::map<int, std::vector<uint32_t>> document_to_minhash_;
+	
+	std::map<int, DocumentData> documents_;
+	std::set<int> document_ids_;
+	// Documents take consecutive slots in the order they are added, so the arrays
+	// indexed by slot stay as long as the number of documents whatever their ids are.
+	// Document id of every slot, -1 for removed documents.
+	IndexVector<int> slot_document_ids_;
+	// Slots of removed documents, renumbered away once they outnumber the live ones
+	size_t removed_slot_count_ = 0;
+	DocumentFilterIndex document_filter_index_;
+	// Word counts indexed by slot, for length-normalized ranking
+	IndexVector<int> document_lengths_;
+	int64_t total_document_length_ = 0;
+	// Changed by every AddDocument and RemoveDocument, tells prepared queries whether their postings are current
+	uint64_t generation_ = 0;
+	// Node i of the last PlaceOnNumaNodes owns the slots in [numa_boundaries_[i], numa_boundaries_[i + 1])
+	std::vector<int> numa_boundaries_;
+
+	// Incremental parts of GetIndexStatistics
+	size_t term_count_ = 0;
+	size_t posting_count_ = 0;
+	size_t posting_memory_usage_ = 0;
+	// Words and map nodes only, words are never removed from the dictionary
+	size_t dictionary_memory_usage_ = 0;
+	// Document counts by the bucket of their length, see IndexStatistics::document_lengths
+	std::vector<size_t> document_length_counts_;
+
+	bool IsStopWord(std::string_view word) const;
+
+	// Term id of an indexed word, -1 for unknown words
+	int FindTermId(std::string_view word) const;
+
+	static bool IsValidWord(std::string_view word);
+
+	// Term ids of tokenized words, indexing new words
+	std::vector<int> AddWords(const std::vector<std::string_view>& words);
+
+	void AddDocumentWords(int document_id, const std::vector<std::string_view>& words, const std::vector<int>& positions,
+		DocumentStatus status, const std::vector<int>& ratings);
+
+	static int ComputeAverageRating(const std::vector<int>& ratings);
+
+	// The order of results, see SearchCursor
+	static bool IsRankedHigher(const Document& lhs, const Document& rhs);
+
+	struct QueryWord {
+		std::string_view data;
+		bool is_minus;
+		bool is_stop;
+		bool is_prefix;
+	};
+
+	QueryWord ParseQueryWord(std::string_view text) const;
+
+	// Indexed words starting with prefix, capped by options_.max_prefix_expansions
+	std::vector<std::string_view> ExpandPrefix(std::string_view prefix) const;
+
+	struct Phrase {
+		// Non-stop words of the phrase with their offsets from its first word
+		std::vector<std::pair<std::string_view, int>> words;
+		bool is_minus;
+	};
+
+	struct Proximity {
+		std::string_view first_word;
+		std::string_view second_word;
+		int max_distance;
+	};
+
+	struct Query {
+		std::set<std::string_view> plus_words;
+		std::set<std::string_view> minus_words;
+		std::vector<Phrase> phrases;
+		std::vector<Proximity> proximities;
+		// Indexed words close to some plus word, with the weight of their relevance
+		std::map<std::string_view, double> fuzzy_words;
+		// Every distinct plus word of the text is a clause. Plus and fuzzy words map to
+		// the bits of the clauses they satisfy, up to MAX_CONJUNCTIVE_QUERY_WORDS clauses.
+		std::map<std::string_view, uint64_t> word_clauses;
+		size_t clause_count = 0;
+	};
+
+	// Collects "quoted phrases" and NEAR/k operators into query and returns the
+	// remaining words, with the words of plus phrases kept as ordinary plus words
+	std::vector<std::string_view> ParsePositionalOperators(const std::vector<std::string_view>& words, Query& query) const;
+
+	bool MatchesPositionalConstraints(const Query& query, int slot) const;
+	bool ContainsPhrase(const Phrase& phrase, int slot) const;
+	std::vector<int> GetWordPositions(std::string_view word, int slot) const;
+
+	template<typename Policy>
+	SearchServer::Query ParseQuery(Policy policy, std::string_view text, const QueryOptions& query_options = {}) const;
+
+	void AddFuzzyWords(std::string_view word, const QueryOptions& query_options, Query& query) const;
+
+	// Words of a query resolved to term ids once, to be matched against many documents
+	struct QueryTerms {
+		std::vector<int> minus_term_ids;
+		// Indexed plus and fuzzy words ordered by term id, viewing the keys of words_
+		std::vector<std::pair<int, std::string_view>> plus_terms;
+	};
+
+	QueryTerms ResolveQueryTerms(const Query& query) const;
+	std::vector<std::string_view> MatchQueryTerms(const Query& query, const QueryTerms& query_terms, int slot) const;
+	// MatchDocuments for ids already checked
+	template <typename Policy>
+	std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchQueryTerms(Policy policy, const Query& query, 
+		const QueryTerms& query_terms, const std::vector<int>& document_ids) const;
+
+	// Postings of a plus word with the inverse document frequency, already weighted,
+	// that its term frequencies are multiplied by
+	struct WordPostings {
+		const PostingList* postings;
+		double inverse_document_freq;
+		// Bits of Query::word_clauses
+		uint64_t clauses;
+	};
+
+	struct QueryPostings {
+		std::vector<WordPostings> plus_postings;
+		std::vector<const PostingList*> minus_postings;
+		size_t plus_posting_count = 0;
+	};
+
+	template <typename Ranking>
+	QueryPostings FetchQueryPostings(const Query& query, const Ranking& ranking) const;
+	// With the ranking model of the server
+	QueryPostings FetchQueryPostings(const Query& query) const;
+
+	void CheckDocumentIds(const std::vector<int>& document_ids) const;
+
+	// Slot of a live document, -1 for unknown ids
+	int FindSlot(int document_id) const;
+	// Gives the live documents consecutive slots in their current order
+	void CompactSlots();
+
+	// Everything about a document except its postings
+	void EraseDocumentData(int document_id);
+
+	// Ascending slots removed from every affected posting list: postings[i] loses
+	// slots[offsets[i]] to slots[offsets[i + 1]]
+	struct PostingRemovals {
+		std::vector<PostingList*> postings;
+		std::vector<size_t> offsets;
+		std::vector<int> slots;
+		// Sizes and memory usages of the posting lists before the removal
+		std::vector<size_t> old_sizes;
+		std::vector<size_t> old_memory_usages;
+	};
+
+	PostingRemovals GroupPostingRemovals(const std::vector<int>& sorted_document_ids);
+	// Everything of RemoveDocuments after the postings are removed
+	void FinishRemovals(const PostingRemovals& removals, const std::vector<int>& sorted_document_ids);
+
+	// Brings the statistics up to date after postings changed from old_size postings of old_memory_usage bytes
+	void UpdatePostingStatistics(const PostingList& postings, size_t old_size, size_t old_memory_usage);
+	static size_t GetDocumentLengthBucket(int length);
+
+	Bm25Ranking MakeBm25Ranking() const;
+
+	// Result for the document in slot
+	Document MakeDocument(int slot, double relevance) const;
+
+	// DocumentFilter is called with a document slot only, so filters backed by
+	// document_filter_index_ never touch documents_
+	template <typename DocumentFilter, typename Policy>
+	std::vector<Document> FindTopDocumentsByFilter(Policy policy, std::string_view raw_query, const QueryOptions& query_options, 
+												   DocumentFilter document_filter) const;
+
+	template <typename DocumentFilter, typename Policy>
+	std::vector<Document> FindTopDocumentsByFilter(Policy policy, const PreparedQuery& query, DocumentFilter document_filter) const;
+
+	template <typename DocumentFilter, typename Policy>
+	std::vector<Document> FindAllDocuments(Policy policy, const PreparedQuery& query, DocumentFilter document_filter) const;
+
+	template <typename DocumentFilter, typename Policy, typename Ranking>
+	std::vector<Document> FindAllDocuments(Policy policy, const PreparedQuery& query, DocumentFilter document_filter, 
+										   const Ranking& ranking) const;
+
+	// Scores into a buffer indexed by slot with the kernels from scoring.h
+	template <typename DocumentFilter, typename Policy, typename Ranking>
+	std::vector<Document> FindAllDocumentsDense(Policy policy, const QueryPostings& query_postings, DocumentFilter document_filter, 
+												const Ranking& ranking) const;
+
+	template <typename DocumentFilter, typename Policy, typename Ranking>
+	std::vector<Document> FindAllDocumentsSparse(ConcurrentMap<int, double>& slot_to_relevance, Policy policy,
+												 const QueryPostings& query_postings, 
+												 DocumentFilter document_filter, const Ranking& ranking) const;
+
+	// Scores only the documents containing at least minimum_should_match clauses: the
+	// candidates come from the rarest clauses, the other postings are galloped through
+	template <typename DocumentFilter, typename Policy, typename Ranking>
+	std::vector<Document> FindAllDocumentsConjunctive(Policy policy, const QueryPostings& query_postings, size_t minimum_should_match,
+													  DocumentFilter document_filter, const Ranking& ranking) const;
+
+	// Scores every node's slot range on the workers of the node
+	template <typename DocumentFilter, typename Ranking>
+	std::vector<Document> FindAllDocumentsNuma(const NumaExecutor& executor, const QueryPostings& query_postings, 
+											   DocumentFilter document_filter, const Ranking& ranking) const;
+
+	// Scores the documents in slots [first_slot, last_slot) into the dense buffer, whose
+	// scores in the range must be UNSCORED, and appends the scored slots
+	template <typename Ranking>
+	void ScoreDocumentRange(const QueryPostings& query_postings, const Ranking& ranking, int first_slot, 
+							int last_slot, double* scores, std::vector<int>& slots) const;
+
+	// Boundaries of the last PlaceOnNumaNodes if it was for node_count nodes, equal slot ranges otherwise
+	std::vector<int> GetNumaBoundaries(size_t node_count) const;
+};
+
+// A query parsed once, with its words resolved to term ids and its postings with
+// their IDFs cached. Prefix and fuzzy expansions are fixed when it is prepared;
+// the postings are fetched again if documents were added or removed since then.
+// Valid while the server that prepared it exists and only with that server.
+class SearchServer::PreparedQuery {
+private:
+	friend class SearchServer;
+
+	PreparedQuery() = default;
+
+	// Query words view this text, kept on the heap so that moves do not invalidate them
+	std::shared_ptr<const std::string> text_;
+	QueryOptions options_;
+	Query query_;
+	QueryTerms terms_;
+	QueryPostings postings_;
+	uint64_t generation_ = 0;
+};
+
+template <typename StringContainer>
+SearchServer::SearchServer(const StringContainer& stop_words, const SearchServerOptions& options)
+	: stop_words_(MakeUniqueNonEmptyStrings(stop_words))  // Extract non-empty stop words
+	, options_(options)
+{
+	if (!std::all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
+		using namespace std::literals::string_literals;
+		throw std::invalid_argument("Some of stop words are invalid"s);
+	}
+}
+
+template <typename DocumentPredicate, typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(Policy policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
+	return FindTopDocuments(policy, raw_query, QueryOptions{}, document_predicate);
+}
+
+template <typename DocumentPredicate, typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(Policy policy, std::string_view raw_query, const QueryOptions& query_options, 
+													 DocumentPredicate document_predicate) const {
+	return FindTopDocumentsByFilter(policy, raw_query, query_options, [this, &document_predicate](int slot) {
+		const int document_id = slot_document_ids_[slot];
+		const auto& document_data = documents_.at(document_id);
+		return document_predicate(document_id, document_data.status, document_data.rating);
+		}
+	);
+}
+
+template <typename Policy>
+SearchServer::PreparedQuery SearchServer::PrepareQuery(Policy policy, std::string_view raw_query, const QueryOptions& query_options) const {
+	PreparedQuery prepared_query;
+	prepared_query.text_ = std::make_shared<const std::string>(raw_query);
+	prepared_query.options_ = query_options;
+	{
+		TRACE_QUERY_PHASE(QueryPhase::PARSE);
+		prepared_query.query_ = ParseQuery(policy, *prepared_query.text_, query_options);
+		prepared_query.terms_ = ResolveQueryTerms(prepared_query.query_);
+	}
+	{
+		TRACE_QUERY_PHASE(QueryPhase::POSTING_FETCH);
+		prepared_query.postings_ = FetchQueryPostings(prepared_query.query_);
+	}
+	prepared_query.generation_ = generation_;
+	return prepared_query;
+}
+
+template <typename DocumentFilter, typename Policy>
+std::vector<Document> SearchServer::FindTopDocumentsByFilter(Policy policy, std::string_view raw_query, const QueryOptions& query_options, 
+															 DocumentFilter document_filter) const {
+	return FindTopDocumentsByFilter(policy, PrepareQuery(policy, raw_query, query_options), document_filter);
+}
+
+template <typename DocumentFilter, typename Policy>
+std::vector<Document> SearchServer::FindTopDocumentsByFilter(Policy policy, const PreparedQuery& prepared_query, 
+															 DocumentFilter document_filter) const {
+	const Query& query = prepared_query.query_;
+
+	auto matched_documents = query.phrases.empty() && query.proximities.empty()
+		? FindAllDocuments(policy, prepared_query, document_filter)
+		: FindAllDocuments(policy, prepared_query, [this, &query, &document_filter](int slot) {
+				return document_filter(slot) && MatchesPositionalConstraints(query, slot);
+			});
+
+	TRACE_QUERY_PHASE(QueryPhase::TOP_K);
+	const QueryOptions& query_options = prepared_query.options_;
+	if (query_options.search_after) {
+		const SearchCursor& cursor = *query_options.search_after;
+		const Document cursor_document(cursor.document_id, cursor.relevance, cursor.rating);
+		matched_documents.erase(std::remove_if(matched_documents.begin(), matched_documents.end(), 
+			[&cursor_document](const Document& document) {
+				return !IsRankedHigher(cursor_document, document);
+			}), matched_documents.end());
+	}
+
+	const size_t first = std::min(query_options.offset, matched_documents.size());
+	const size_t last = first + std::min(query_options.limit, matched_documents.size() - first);
+	partial_sort(matched_documents.begin(), matched_documents.begin() + last, matched_documents.end(), IsRankedHigher);
+	matched_documents.resize(last);
+	matched_documents.erase(matched_documents.begin(), matched_documents.begin() + first);
+
+	if (query_options.with_matched_words) {
+		const auto match_document = [this, &prepared_query](Document& document) {
+			document.matched_words = MatchQueryTerms(prepared_query.query_, prepared_query.terms_, FindSlot(document.id));
+		};
+		// NumaPolicy only schedules scoring, the few results are matched right here
+		if constexpr (std::is_same_v<std::decay_t<Policy>, NumaPolicy>) {
+			std::for_each(matched_documents.begin(), matched_documents.end(), match_document);
+		}
+		else {
+			std::for_each(policy, matched_documents.begin(), matched_documents.end(), match_document);
+		}
+	}
+
+	return matched_documents;
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+	return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+}
+
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(Policy policy, std::string_view raw_query, DocumentStatus status) const {
+	return FindTopDocuments(policy, raw_query, QueryOptions{}, status);
+}
+
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(Policy policy, std::string_view raw_query, const QueryOptions& query_options, 
+													 DocumentStatus status) const {
+	return FindTopDocumentsByFilter(policy, raw_query, query_options, [this, status](int slot) {
+		return document_filter_index_.Matches(slot, status);
+		}
+	);
+}
+
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(Policy policy, std::string_view raw_query, RatingRange rating_range) const {
+	return FindTopDocumentsByFilter(policy, raw_query, QueryOptions{}, [this, rating_range](int slot) {
+		return document_filter_index_.Matches(slot, rating_range);
+		}
+	);
+}
+
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(Policy policy, std::string_view raw_query, DocumentStatus status, 
+													 RatingRange rating_range) const {
+	return FindTopDocumentsByFilter(policy, raw_query, QueryOptions{}, [this, status, rating_range](int slot) {
+		return document_filter_index_.Matches(slot, status, rating_range);
+		}
+	);
+}
+
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(Policy policy, std::string_view raw_query) const {
+	return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(Policy policy, std::string_view raw_query, const QueryOptions& query_options) const {
+	return FindTopDocuments(policy, raw_query, query_options, DocumentStatus::ACTUAL);
+}
+
+template <typename DocumentPredicate, typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(Policy policy, const PreparedQuery& query, DocumentPredicate document_predicate) const {
+	return FindTopDocumentsByFilter(policy, query, [this, &document_predicate](int slot) {
+		const int document_id = slot_document_ids_[slot];
+		const auto& document_data = documents_.at(document_id);
+		return document_predicate(document_id, document_data.status, document_data.rating);
+		}
+	);
+}
+
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(Policy policy, const PreparedQuery& query, DocumentStatus status) const {
+	return FindTopDocumentsByFilter(policy, query, [this, status](int slot) {
+		return document_filter_index_.Matches(slot, status);
+		}
+	);
+}
+
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(Policy policy, const PreparedQuery& query) const {
+	return FindTopDocuments(policy, query, DocumentStatus::ACTUAL);
+}
+
+template <typename Policy>
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(Policy policy, std::string_view raw_query, 
+																					  int document_id) const {
+	if (document_ids_.find(document_id) == document_ids_.end()) {
+		using namespace std::literals::string_literals;
+		throw std::invalid_argument("Invalid document_id"s);
+	}
+
+	const auto query = ParseQuery(policy, raw_query);
+	const DocumentData& document_data = documents_.at(document_id);
+	return { MatchQueryTerms(query, ResolveQueryTerms(query), document_data.slot), document_data.status };
+}
+
+template <typename Policy>
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(Policy policy, 
+	std::string_view raw_query, const std::vector<int>& document_ids) const {
+	CheckDocumentIds(document_ids);
+	// Matching reads no postings, so the query is only parsed
+	const Query query = ParseQuery(policy, raw_query);
+	return MatchQueryTerms(policy, query, ResolveQueryTerms(query), document_ids);
+}
+
+template <typename Policy>
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(Policy policy, 
+	const PreparedQuery& query, const std::vector<int>& document_ids) const {
+	CheckDocumentIds(document_ids);
+	return MatchQueryTerms(policy, query.query_, query.terms_, document_ids);
+}
+
+template <typename Policy>
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchQueryTerms(Policy policy, 
+	const Query& query, const QueryTerms& query_terms, const std::vector<int>& document_ids) const {
+	std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> matches(document_ids.size());
+	const auto match_document = [this, &query, &query_terms](int document_id) {
+		const DocumentData& document_data = documents_.at(document_id);
+		return std::tuple{ MatchQueryTerms(query, query_terms, document_data.slot), document_data.status };
+	};
+	// NumaPolicy only schedules scoring, documents are matched right here
+	if constexpr (std::is_same_v<std::decay_t<Policy>, NumaPolicy>) {
+		std::transform(document_ids.begin(), document_ids.end(), matches.begin(), match_document);
+	}
+	else {
+		std::transform(policy, document_ids.begin(), document_ids.end(), matches.begin(), match_document);
+	}
+	return matches;
+}
+
+template <typename Policy>
+void SearchServer::RemoveDocument(Policy policy, int document_id) {
+	auto document_ids_it = document_ids_.find(document_id);
+
+	if (document_ids_it == document_ids_.end()) {
+		using namespace std::literals::string_literals;
+		throw std::invalid_argument("Invalid document_id"s);
+	}
+
+	const int slot = documents_.at(document_id).slot;
+	const TermIds term_ids = forward_index_.GetTermIds(slot);
+	std::vector<PostingList*> term_postings(term_ids.size());
+	std::vector<size_t> memory_usages(term_ids.size());
+	for (size_t i = 0; i < term_ids.size(); ++i) {
+		term_postings[i] = &word_to_document_freqs_.find(term_words_[term_ids[i]])->second;
+		memory_usages[i] = term_postings[i]->GetMemoryUsage();
+	}
+	std::for_each(policy, term_postings.begin(), term_postings.end(), 
+			[slot](PostingList* postings) {
+				postings->Remove(slot);
+			}
+	);
+	for (size_t i = 0; i < term_postings.size(); ++i) {
+		UpdatePostingStatistics(*term_postings[i], term_postings[i]->size() + 1, memory_usages[i]);
+	}
+
+	EraseDocumentData(document_id);
+	if (removed_slot_count_ > documents_.size()) {
+		CompactSlots();
+	}
+	++generation_;
+}
+
+template <typename Policy>
+void SearchServer::RemoveDocuments(Policy policy, const std::vector<int>& document_ids) {
+	CheckDocumentIds(document_ids);
+	std::vector<int> sorted_ids = document_ids;
+	std::sort(sorted_ids.begin(), sorted_ids.end());
+	sorted_ids.erase(std::unique(sorted_ids.begin(), sorted_ids.end()), sorted_ids.end());
+
+	// Every task owns one posting list, so lists are rewritten in parallel without locks
+	const PostingRemovals removals = GroupPostingRemovals(sorted_ids);
+	std::vector<size_t> indexes(removals.postings.size());
+	std::iota(indexes.begin(), indexes.end(), 0);
+	std::for_each(policy, indexes.begin(), indexes.end(), [&removals](size_t i) {
+		const int* const removed_slots = removals.slots.data();
+		removals.postings[i]->Remove(removed_slots + removals.offsets[i], removed_slots + removals.offsets[i + 1]);
+		});
+	FinishRemovals(removals, sorted_ids);
+}
+
+template<typename Policy>
+SearchServer::Query SearchServer::ParseQuery(Policy policy, std::string_view text, const QueryOptions& query_options) const {
+
+	Query result;
+
+	auto words = SplitIntoWords(text);
+	if (options_.store_word_positions) {
+		words = ParsePositionalOperators(words, result);
+	}
+	std::vector<QueryWord> query_words(words.size());
+	const auto parse_query_word = [this](std::string_view word) {return ParseQueryWord(word); };
+	// NumaPolicy only schedules scoring, queries are parsed right here
+	if constexpr (std::is_same_v<std::decay_t<Policy>, NumaPolicy>) {
+		std::transform(words.begin(), words.end(), query_words.begin(), parse_query_word);
+	}
+	else if (words.size() < PARALLEL_QUERY_PARSING_MIN_WORDS) {
+		std::transform(words.begin(), words.end(), query_words.begin(), parse_query_word);
+	}
+	else {
+		std::transform(policy, words.begin(), words.end(), query_words.begin(), parse_query_word);
+	}
+
+	// Clause indexes of the distinct plus words, "cat" and "cat*" being different words
+	std::map<std::pair<std::string_view, bool>, size_t> clauses;
+	for (QueryWord& query_word : query_words) {
+		if (query_word.is_stop) {
+			continue;
+		}
+		auto& query_words_set = query_word.is_minus ? result.minus_words : result.plus_words;
+		uint64_t clause_bit = 0;
+		if (!query_word.is_minus) {
+			const size_t clause = clauses.emplace(std::pair{ query_word.data, query_word.is_prefix }, clauses.size()).first->second;
+			clause_bit = clause < MAX_CONJUNCTIVE_QUERY_WORDS ? uint64_t{ 1 } << clause : 0;
+		}
+		const auto add_word = [&](std::string_view word) {
+			query_words_set.insert(word);
+			if (!query_word.is_minus) {
+				result.word_clauses[word] |= clause_bit;
+			}
+		};
+		if (query_word.is_prefix) {
+			for (std::string_view word : ExpandPrefix(query_word.data)) {
+				add_word(word);
+			}
+		}
+		else {
+			add_word(query_word.data);
+		}
+	}
+	result.clause_count = clauses.size();
+	if (query_options.minimum_should_match > 1 && result.clause_count > MAX_CONJUNCTIVE_QUERY_WORDS) {
+		using namespace std::literals::string_literals;
+		throw std::invalid_argument("Query has too many words for minimum_should_match"s);
+	}
+
+	if (query_options.max_edit_distance != 0) {
+		for (std::string_view word : result.plus_words) {
+			AddFuzzyWords(word, query_options, result);
+		}
+	}
+	return result;
+}
+
+template <typename DocumentFilter, typename Policy>
+std::vector<Document> SearchServer::FindAllDocuments(Policy policy, const PreparedQuery& query, DocumentFilter document_filter) const {
+	// The model is chosen once per query, the loops below are compiled per model
+	switch (options_.ranking_model) {
+	case RankingModel::BM25:
+		return FindAllDocuments(policy, query, document_filter, MakeBm25Ranking());
+	default:
+		return FindAllDocuments(policy, query, document_filter, TfIdfRanking{});
+	}
+}
+
+template <typename Ranking>
+SearchServer::QueryPostings SearchServer::FetchQueryPostings(const SearchServer::Query& query, const Ranking& ranking) const {
+	QueryPostings query_postings;
+	const auto add_plus_word = [this, &query, &ranking, &query_postings](std::string_view word, double weight) {
+		const auto postings_it = word_to_document_freqs_.find(word);
+		if (postings_it != word_to_document_freqs_.end() && !postings_it->second.empty()) {
+			const PostingList& postings = postings_it->second;
+			const double inverse_document_freq = ranking.ComputeInverseDocumentFreq(GetDocumentCount(), postings.size());
+			query_postings.plus_postings.push_back({ &postings, inverse_document_freq * weight, query.word_clauses.at(word) });
+			query_postings.plus_posting_count += postings.size();
+		}
+	};
+	for (std::string_view word : query.plus_words) {
+		add_plus_word(word, 1.0);
+	}
+	for (const auto [word, weight] : query.fuzzy_words) {
+		add_plus_word(word, weight);
+	}
+
+	for (std::string_view word : query.minus_words) {
+		const auto postings_it = word_to_document_freqs_.find(word);
+		if (postings_it != word_to_document_freqs_.end()) {
+			query_postings.minus_postings.push_back(&postings_it->second);
+		}
+	}
+	return query_postings;
+}
+
+template <typename DocumentFilter, typename Policy, typename Ranking>
+std::vector<Document> SearchServer::FindAllDocuments(Policy policy, const PreparedQuery& query, DocumentFilter document_filter, 
+													 const Ranking& ranking) const {
+	const bool is_current = query.generation_ == generation_;
+	const QueryPostings refetched_postings = is_current ? QueryPostings{} : FetchQueryPostings(query.query_, ranking);
+	const QueryPostings& query_postings = is_current ? query.postings_ : refetched_postings;
+	if (query_postings.plus_posting_count == 0) {
+		return {};
+	}
+
+	const size_t minimum_should_match = std::min(query.options_.minimum_should_match, query.query_.clause_count);
+	if (minimum_should_match > 1) {
+		// Galloping leaves little work for the nodes, NumaPolicy runs it right here
+		if constexpr (std::is_same_v<std::decay_t<Policy>, NumaPolicy>) {
+			return FindAllDocumentsConjunctive(std::execution::seq, query_postings, minimum_should_match, document_filter, ranking);
+		}
+		else {
+			return FindAllDocumentsConjunctive(policy, query_postings, minimum_should_match, document_filter, ranking);
+		}
+	}
+
+	if constexpr (std::is_same_v<std::decay_t<Policy>, NumaPolicy>) {
+		return FindAllDocumentsNuma(*policy.executor, query_postings, document_filter, ranking);
+	}
+	else {
+		if (query_postings.plus_posting_count * DENSE_SCORING_MAX_SPARSITY >= slot_document_ids_.size()) {
+			return FindAllDocumentsDense(policy, query_postings, document_filter, ranking);
+		}
+
+		const size_t bucket_count = std::is_same_v<std::decay_t<Policy>, std::execution::sequenced_policy> ? 1 : 240;
+		ConcurrentMap<int, double> slot_to_relevance(bucket_count, query_postings.plus_posting_count);
+		return FindAllDocumentsSparse(slot_to_relevance, policy, query_postings, document_filter, ranking);
+	}
+}
+
+template <typename DocumentFilter, typename Policy, typename Ranking>
+std::vector<Document> SearchServer::FindAllDocumentsDense(Policy policy, const QueryPostings& query_postings, DocumentFilter document_filter, 
+														  const Ranking& ranking) const {
+	TRACE_QUERY_PHASE(QueryPhase::SCORE);
+	const int slot_count = static_cast<int>(slot_document_ids_.size());
+	std::vector<double> scores(slot_count, UNSCORED);
+
+	// Every chunk owns a disjoint range of slots, so chunks never write the same score
+	const int chunk_count = std::is_same_v<std::decay_t<Policy>, std::execution::sequenced_policy> ? 1 : DENSE_SCORING_CHUNK_COUNT;
+	std::vector<int> chunks(chunk_count);
+	std::iota(chunks.begin(), chunks.end(), 0);
+	std::vector<std::vector<int>> chunk_slots(chunk_count);
+
+	std::for_each(policy, chunks.begin(), chunks.end(), 
+		[&](int chunk) {
+			const int first_slot = static_cast<int>(static_cast<int64_t>(slot_count) * chunk / chunk_count);
+			const int last_slot = static_cast<int>(static_cast<int64_t>(slot_count) * (chunk + 1) / chunk_count);
+			ScoreDocumentRange(query_postings, ranking, first_slot, last_slot, scores.data(), chunk_slots[chunk]);
+		}
+	);
+
+	size_t candidate_count = 0;
+	for (const auto& slots : chunk_slots) {
+		candidate_count += slots.size();
+	}
+	std::vector<Document> matched_documents;
+	matched_documents.reserve(candidate_count);
+	for (const auto& slots : chunk_slots) {
+		for (const int slot : slots) {
+			if (document_filter(slot)) {
+				matched_documents.push_back(MakeDocument(slot, scores[slot]));
+			}
+		}
+	}
+	return matched_documents;
+}
+
+template <typename DocumentFilter, typename Policy, typename Ranking>
+std::vector<Document> SearchServer::FindAllDocumentsSparse(ConcurrentMap<int, double>& slot_to_relevance, Policy policy,
+	const QueryPostings& query_postings,
+	DocumentFilter document_filter, const Ranking& ranking) const {
+
+	{
+		TRACE_QUERY_PHASE(QueryPhase::SCORE);
+		std::for_each(policy,
+			query_postings.plus_postings.begin(),
+			query_postings.plus_postings.end(),
+			[&document_filter, &slot_to_relevance, &ranking](const WordPostings& word_postings) {
+				const PostingList& postings = *word_postings.postings;
+				for (size_t i = 0; i < postings.size(); ++i) {
+					const int slot = postings.slots[i];
+					if (document_filter(slot)) {
+						slot_to_relevance.Add(slot, ranking.ComputeScore(slot, postings.term_freqs[i], word_postings.inverse_document_freq));
+					}
+				}
+			}
+		);
+	}
+
+	{
+		TRACE_QUERY_PHASE(QueryPhase::MINUS_FILTER);
+		for (const PostingList* postings : query_postings.minus_postings) {
+			for (const int slot : postings->slots) {
+				slot_to_relevance.erase(slot);
+			}
+		}
+	}
+
+	std::vector<Document> matched_documents;
+	matched_documents.reserve(slot_to_relevance.size());
+	for (const auto [slot, relevance] : slot_to_relevance) {
+		matched_documents.push_back(MakeDocument(slot, relevance));
+	}
+	return matched_documents;
+}
+
+template <typename DocumentFilter, typename Policy, typename Ranking>
+std::vector<Document> SearchServer::FindAllDocumentsConjunctive(Policy policy, const QueryPostings& query_postings, 
+																size_t minimum_should_match, DocumentFilter document_filter, 
+																const Ranking& ranking) const {
+	TRACE_QUERY_PHASE(QueryPhase::SCORE);
+	const auto count_clauses = [](uint64_t clauses) {
+		return std::bitset<MAX_CONJUNCTIVE_QUERY_WORDS>(clauses).count();
+	};
+
+	// Rarest words first, so that candidates short of clauses are dropped before the long lists are touched
+	std::vector<WordPostings> words = query_postings.plus_postings;
+	std::sort(words.begin(), words.end(), [](const WordPostings& lhs, const WordPostings& rhs) {
+		return lhs.postings->size() < rhs.postings->size();
+		});
+	// remaining_clauses[i] are the clauses that words[i..] can still add
+	std::vector<uint64_t> remaining_clauses(words.size() + 1, 0);
+	for (size_t i = words.size(); i > 0; --i) {
+		remaining_clauses[i - 1] = remaining_clauses[i] | words[i - 1].clauses;
+	}
+
+	std::vector<std::pair<size_t, uint64_t>> clause_posting_counts;
+	for (size_t clause = 0; clause < MAX_CONJUNCTIVE_QUERY_WORDS; ++clause) {
+		const uint64_t clause_bit = uint64_t{ 1 } << clause;
+		size_t posting_count = 0;
+		for (const WordPostings& word : words) {
+			posting_count += word.clauses & clause_bit ? word.postings->size() : 0;
+		}
+		if (posting_count > 0) {
+			clause_posting_counts.push_back({ posting_count, clause_bit });
+		}
+	}
+	if (clause_posting_counts.size() < minimum_should_match) {
+		return {};
+	}
+
+	// A document with minimum_should_match of the k clauses has one of any k - minimum_should_match + 1
+	// of them, so the documents of the rarest ones are all the candidates
+	std::sort(clause_posting_counts.begin(), clause_posting_counts.end());
+	uint64_t candidate_clauses = 0;
+	for (size_t i = 0; i + minimum_should_match <= clause_posting_counts.size(); ++i) {
+		candidate_clauses |= clause_posting_counts[i].second;
+	}
+	std::vector<int> candidates;
+	for (const WordPostings& word : words) {
+		if (word.clauses & candidate_clauses) {
+			const size_t middle = candidates.size();
+			candidates.insert(candidates.end(), word.postings->slots.begin(), word.postings->slots.end());
+			std::inplace_merge(candidates.begin(), candidates.begin() + middle, candidates.end());
+		}
+	}
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	// Every chunk walks its own cursors over ascending candidates
+	const int chunk_count = std::is_same_v<std::decay_t<Policy>, std::execution::sequenced_policy> ? 1 : DENSE_SCORING_CHUNK_COUNT;
+	std::vector<int> chunks(chunk_count);
+	std::iota(chunks.begin(), chunks.end(), 0);
+	std::vector<std::vector<Document>> chunk_documents(chunk_count);
+
+	std::for_each(policy, chunks.begin(), chunks.end(), 
+		[&](int chunk) {
+			const size_t first = candidates.size() * chunk / chunk_count;
+			const size_t last = candidates.size() * (chunk + 1) / chunk_count;
+			std::vector<const int*> cursors;
+			for (const WordPostings& word : words) {
+				cursors.push_back(word.postings->slots.data());
+			}
+			std::vector<const int*> minus_cursors;
+			for (const PostingList* postings : query_postings.minus_postings) {
+				minus_cursors.push_back(postings->slots.data());
+			}
+
+			for (size_t candidate = first; candidate < last; ++candidate) {
+				const int slot = candidates[candidate];
+				uint64_t clauses = 0;
+				double relevance = 0.0;
+				size_t i = 0;
+				for (; i < words.size() && count_clauses(clauses | remaining_clauses[i]) >= minimum_should_match; ++i) {
+					const PostingList& postings = *words[i].postings;
+					const int* const end = postings.slots.data() + postings.size();
+					cursors[i] = GallopLowerBound(cursors[i], end, slot);
+					if (cursors[i] != end && *cursors[i] == slot) {
+						clauses |= words[i].clauses;
+						relevance += ranking.ComputeScore(slot, postings.term_freqs[cursors[i] - postings.slots.data()], 
+														  words[i].inverse_document_freq);
+					}
+				}
+				if (i < words.size() || count_clauses(clauses) < minimum_should_match || !document_filter(slot)) {
+					continue;
+				}
+
+				bool is_excluded = false;
+				for (size_t j = 0; j < minus_cursors.size() && !is_excluded; ++j) {
+					const int* const end = query_postings.minus_postings[j]->slots.data() + query_postings.minus_postings[j]->size();
+					minus_cursors[j] = GallopLowerBound(minus_cursors[j], end, slot);
+					is_excluded = minus_cursors[j] != end && *minus_cursors[j] == slot;
+				}
+				if (!is_excluded) {
+					chunk_documents[chunk].push_back(MakeDocument(slot, relevance));
+				}
+			}
+		}
+	);
+
+	std::vector<Document> matched_documents;
+	for (std::vector<Document>& documents : chunk_documents) {
+		matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+	}
+	return matched_documents;
+}
+
+template <typename DocumentFilter, typename Ranking>
+std::vector<Document> SearchServer::FindAllDocumentsNuma(const NumaExecutor& executor, const QueryPostings& query_postings, 
+														 DocumentFilter document_filter, const Ranking& ranking) const {
+	TRACE_QUERY_PHASE(QueryPhase::SCORE);
+	const int slot_count = static_cast<int>(slot_document_ids_.size());
+	const std::vector<int> boundaries = GetNumaBoundaries(executor.GetNodeCount());
+	const bool is_dense = query_postings.plus_posting_count * DENSE_SCORING_MAX_SPARSITY >= static_cast<size_t>(slot_count);
+	// Left unwritten here, so that the scores of every range are first written, and placed, by its node
+	const std::unique_ptr<double[]> scores(is_dense ? new double[slot_count] : nullptr);
+
+	// Slots of the scored documents that pass the filter, by node and worker. Sparse
+	// queries have no dense buffer and keep the relevance next to the slot instead.
+	std::vector<std::vector<std::vector<int>>> node_slots(executor.GetNodeCount());
+	std::vector<std::vector<std::vector<std::pair<int, double>>>> node_relevances(executor.GetNodeCount());
+	for (size_t node = 0; node < node_slots.size(); ++node) {
+		node_slots[node].resize(executor.GetWorkerCount(node));
+		node_relevances[node].resize(executor.GetWorkerCount(node));
+	}
+
+	executor.Run([&](size_t node, size_t worker) {
+		// Every worker of the node takes an equal part of the node's range
+		const int64_t node_first = std::min(boundaries[node], slot_count);
+		const int64_t node_last = std::min(boundaries[node + 1], slot_count);
+		const int64_t worker_count = executor.GetWorkerCount(node);
+		const int first_slot = static_cast<int>(node_first + (node_last - node_first) * worker / worker_count);
+		const int last_slot = static_cast<int>(node_first + (node_last - node_first) * (worker + 1) / worker_count);
+
+		if (is_dense) {
+			std::fill(scores.get() + first_slot, scores.get() + last_slot, UNSCORED);
+			std::vector<int>& slots = node_slots[node][worker];
+			ScoreDocumentRange(query_postings, ranking, first_slot, last_slot, scores.get(), slots);
+			slots.erase(std::remove_if(slots.begin(), slots.end(), [&document_filter](int slot) {
+				return !document_filter(slot);
+				}), slots.end());
+			return;
+		}
+
+		ConcurrentMap<int, double> slot_to_relevance(1);
+		for (const auto [postings, inverse_document_freq, clauses] : query_postings.plus_postings) {
+			const auto [first, last] = postings->FindRange(first_slot, last_slot);
+			for (size_t i = first; i < last; ++i) {
+				const int slot = postings->slots[i];
+				if (document_filter(slot)) {
+					slot_to_relevance.Add(slot, ranking.ComputeScore(slot, postings->term_freqs[i], inverse_document_freq));
+				}
+			}
+		}
+		for (const PostingList* postings : query_postings.minus_postings) {
+			const auto [first, last] = postings->FindRange(first_slot, last_slot);
+			for (size_t i = first; i < last; ++i) {
+				slot_to_relevance.erase(postings->slots[i]);
+			}
+		}
+		node_relevances[node][worker] = slot_to_relevance.BuildVector();
+		});
+
+	size_t document_count = 0;
+	for (size_t node = 0; node < node_slots.size(); ++node) {
+		for (size_t worker = 0; worker < node_slots[node].size(); ++worker) {
+			document_count += node_slots[node][worker].size() + node_relevances[node][worker].size();
+		}
+	}
+	std::vector<Document> matched_documents;
+	matched_documents.reserve(document_count);
+	for (size_t node = 0; node < node_slots.size(); ++node) {
+		for (size_t worker = 0; worker < node_slots[node].size(); ++worker) {
+			for (const int slot : node_slots[node][worker]) {
+				matched_documents.push_back(MakeDocument(slot, scores[slot]));
+			}
+			for (const auto& [slot, relevance] : node_relevances[node][worker]) {
+				matched_documents.push_back(MakeDocument(slot, relevance));
+			}
+		}
+	}
+	return matched_documents;
+}
+
+template <typename Ranking>
+void SearchServer::ScoreDocumentRange(const QueryPostings& query_postings, const Ranking& ranking, int first_slot, 
+									  int last_slot, double* scores, std::vector<int>& slots) const {
+	for (const auto [postings, inverse_document_freq, clauses] : query_postings.plus_postings) {
+		const auto [first, last] = postings->FindRange(first_slot, last_slot);
+		ranking.AccumulateScores(postings->slots.data() + first, postings->term_freqs.data() + first, last - first,
+								 inverse_document_freq, scores);
+	}
+	for (const PostingList* postings : query_postings.minus_postings) {
+		const auto [first, last] = postings->FindRange(first_slot, last_slot);
+		for (size_t i = first; i < last; ++i) {
+			scores[postings->slots[i]] = UNSCORED;
+		}
+	}
+	CollectScoredDocuments(scores, first_slot, last_slot, slots);
 }
\ No newline at end of file
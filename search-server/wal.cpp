@@ -0,0 +1,248 @@
+#include "wal.h"
+
+#include <array>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Records longer than this are treated as corruption rather than allocated
+const uint32_t MAX_RECORD_SIZE = uint32_t{ 1 } << 30;
+
+const array<uint32_t, 256>& GetCrc32Table() {
+	static const array<uint32_t, 256> table = [] {
+		array<uint32_t, 256> result{};
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t value = i;
+			for (int bit = 0; bit < 8; ++bit) {
+				value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+			}
+			result[i] = value;
+		}
+		return result;
+	}();
+	return table;
+}
+
+uint32_t ComputeCrc32(const char* data, size_t size) {
+	const auto& table = GetCrc32Table();
+	uint32_t crc = 0xFFFFFFFFu;
+	for (size_t i = 0; i < size; ++i) {
+		crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+	}
+	return crc ^ 0xFFFFFFFFu;
+}
+
+// Integers are stored little-endian whatever the byte order of the machine
+void PutUint32(uint32_t value, vector<char>& out) {
+	for (int i = 0; i < 4; ++i) {
+		out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+	}
+}
+
+uint32_t GetUint32(const char* data) {
+	uint32_t value = 0;
+	for (int i = 0; i < 4; ++i) {
+		value |= static_cast<uint32_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+	}
+	return value;
+}
+
+void EncodeRecord(const WalRecord& record, vector<char>& out) {
+	const size_t frame_begin = out.size();
+	PutUint32(0, out);
+	PutUint32(0, out);
+	const size_t payload_begin = out.size();
+
+	out.push_back(static_cast<char>(record.type));
+	PutUint32(static_cast<uint32_t>(record.document_id), out);
+	if (record.type == WalRecordType::ADD_DOCUMENT) {
+		out.push_back(static_cast<char>(record.status));
+		PutUint32(static_cast<uint32_t>(record.ratings.size()), out);
+		for (const int rating : record.ratings) {
+			PutUint32(static_cast<uint32_t>(rating), out);
+		}
+		PutUint32(static_cast<uint32_t>(record.text.size()), out);
+		out.insert(out.end(), record.text.begin(), record.text.end());
+	}
+
+	const size_t payload_size = out.size() - payload_begin;
+	vector<char> header;
+	PutUint32(static_cast<uint32_t>(payload_size), header);
+	PutUint32(ComputeCrc32(out.data() + payload_begin, payload_size), header);
+	copy(header.begin(), header.end(), out.begin() + frame_begin);
+}
+
+// False for payloads that do not hold a whole record
+bool DecodeRecord(const vector<char>& payload, WalRecord& record) {
+	size_t position = 0;
+	const auto has = [&payload, &position](size_t size) {
+		return payload.size() - position >= size;
+	};
+	if (!has(5)) {
+		return false;
+	}
+	record.type = static_cast<WalRecordType>(payload[position]);
+	record.document_id = static_cast<int>(GetUint32(payload.data() + position + 1));
+	position += 5;
+	if (record.type == WalRecordType::REMOVE_DOCUMENT) {
+		return position == payload.size();
+	}
+	if (record.type != WalRecordType::ADD_DOCUMENT || !has(5)) {
+		return false;
+	}
+	record.status = static_cast<DocumentStatus>(payload[position]);
+	const uint32_t rating_count = GetUint32(payload.data() + position + 1);
+	position += 5;
+	if (!has(static_cast<size_t>(rating_count) * 4 + 4)) {
+		return false;
+	}
+	record.ratings.resize(rating_count);
+	for (int& rating : record.ratings) {
+		rating = static_cast<int>(GetUint32(payload.data() + position));
+		position += 4;
+	}
+	const uint32_t text_size = GetUint32(payload.data() + position);
+	position += 4;
+	if (payload.size() - position != text_size) {
+		return false;
+	}
+	record.text.assign(payload.data() + position, text_size);
+	return true;
+}
+
+}  // namespace
+
+WriteAheadLog::WriteAheadLog(const string& path)
+	: file_(fopen(path.c_str(), "ab")) {
+	if (!file_) {
+		throw runtime_error("Cannot open write-ahead log "s + path);
+	}
+}
+
+WriteAheadLog::~WriteAheadLog() {
+	try {
+		Sync();
+	}
+	catch (...) {
+	}
+	fclose(file_);
+}
+
+uint64_t WriteAheadLog::Append(const WalRecord& record) {
+	lock_guard lock(mutex_);
+	EncodeRecord(record, buffer_);
+	return ++appended_count_;
+}
+
+void WriteAheadLog::Sync(uint64_t sequence_number) {
+	unique_lock lock(mutex_);
+	// A number from another log would otherwise wait for records that never come
+	sequence_number = min(sequence_number, appended_count_);
+	while (synced_count_ < sequence_number) {
+		if (is_syncing_) {
+			synced_.wait(lock);
+			continue;
+		}
+		// This thread syncs for everyone who appended so far, the others wait for it
+		is_syncing_ = true;
+		try {
+			WriteBuffer();
+		}
+		catch (...) {
+			is_syncing_ = false;
+			synced_.notify_all();
+			throw;
+		}
+		const uint64_t sync_count = written_count_;
+		lock.unlock();
+#ifdef _WIN32
+		const bool is_synced = _commit(_fileno(file_)) == 0;
+#else
+		const bool is_synced = fsync(fileno(file_)) == 0;
+#endif
+		lock.lock();
+		is_syncing_ = false;
+		if (is_synced) {
+			synced_count_ = max(synced_count_, sync_count);
+		}
+		synced_.notify_all();
+		if (!is_synced) {
+			throw runtime_error("Cannot sync write-ahead log"s);
+		}
+	}
+}
+
+void WriteAheadLog::Sync() {
+	uint64_t appended_count;
+	{
+		lock_guard lock(mutex_);
+		appended_count = appended_count_;
+	}
+	Sync(appended_count);
+}
+
+void WriteAheadLog::Flush() {
+	lock_guard lock(mutex_);
+	WriteBuffer();
+}
+
+void WriteAheadLog::WriteBuffer() {
+	if (!buffer_.empty()) {
+		if (fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()) {
+			throw runtime_error("Cannot write to write-ahead log"s);
+		}
+		buffer_.clear();
+	}
+	if (fflush(file_) != 0) {
+		throw runtime_error("Cannot write to write-ahead log"s);
+	}
+	written_count_ = appended_count_;
+}
+
+uint64_t WriteAheadLog::Replay(const string& path, const function<void(const WalRecord&)>& handler) {
+	FILE* const file = fopen(path.c_str(), "rb");
+	if (!file) {
+		return 0;
+	}
+	uint64_t intact_length = 0;
+	char header[8];
+	vector<char> payload;
+	WalRecord record;
+	try {
+		while (fread(header, 1, sizeof(header), file) == sizeof(header)) {
+			const uint32_t payload_size = GetUint32(header);
+			if (payload_size > MAX_RECORD_SIZE) {
+				break;
+			}
+			payload.resize(payload_size);
+			if (fread(payload.data(), 1, payload_size, file) != payload_size
+				|| ComputeCrc32(payload.data(), payload_size) != GetUint32(header + 4)
+				|| !DecodeRecord(payload, record)) {
+				break;
+			}
+			handler(record);
+			intact_length += sizeof(header) + payload_size;
+		}
+	}
+	catch (...) {
+		fclose(file);
+		throw;
+	}
+	fclose(file);
+	return intact_length;
+}
+
+void WriteAheadLog::Truncate(const string& path, uint64_t length) {
+	if (filesystem::exists(path) && filesystem::file_size(path) > length) {
+		filesystem::resize_file(path, length);
+	}
+}
\ No newline at end of file
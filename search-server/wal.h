@@ -0,0 +1,71 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "document.h"
+
+enum class WalRecordType : uint8_t {
+	ADD_DOCUMENT = 1,
+	REMOVE_DOCUMENT = 2,
+};
+
+struct WalRecord {
+	WalRecordType type = WalRecordType::ADD_DOCUMENT;
+	int document_id = 0;
+	// The rest is used by ADD_DOCUMENT only
+	DocumentStatus status = DocumentStatus::ACTUAL;
+	std::vector<int> ratings;
+	std::string text;
+};
+
+// Append-only log file of index mutations. Every record is framed by its length
+// and a CRC32, so a torn or corrupted tail left by a crash is detected on replay.
+// Appends are buffered in memory; Sync makes them durable, and threads syncing at
+// the same time share one write and fsync (group commit).
+class WriteAheadLog {
+public:
+	// Opens the log for appending, creating it if needed
+	explicit WriteAheadLog(const std::string& path);
+	WriteAheadLog(const WriteAheadLog&) = delete;
+	WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+	~WriteAheadLog();
+
+	// Sequence number of the record, to be passed to Sync
+	uint64_t Append(const WalRecord& record);
+
+	// Returns once every record up to sequence_number is on disk. Numbers past the
+	// last appended record wait for the records appended so far only.
+	void Sync(uint64_t sequence_number);
+	// Every record appended so far
+	void Sync();
+	// Hands the buffered records to the OS without waiting for the disk,
+	// they then survive a crash of the process but not of the machine
+	void Flush();
+
+	// Passes every intact record of the file to handler in order and returns the
+	// length of the intact prefix. A missing file has no records.
+	static uint64_t Replay(const std::string& path, const std::function<void(const WalRecord&)>& handler);
+
+	// Cuts the file to length, used to drop a torn tail before appending to it
+	static void Truncate(const std::string& path, uint64_t length);
+
+private:
+	std::FILE* file_;
+
+	std::mutex mutex_;
+	std::condition_variable synced_;
+	std::vector<char> buffer_;
+	uint64_t appended_count_ = 0;
+	uint64_t written_count_ = 0;
+	uint64_t synced_count_ = 0;
+	bool is_syncing_ = false;
+
+	// Writes the buffer to the file, with the mutex held
+	void WriteBuffer();
+};
\ No newline at end of file